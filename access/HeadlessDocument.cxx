@@ -0,0 +1,457 @@
+// Lexilla lexer library
+/** @file HeadlessDocument.cxx
+ ** Document for running lexers without Scintilla.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+#if !_WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <windows.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEADLESS_SSE2 1
+#endif
+
+#include "ILexer.h"
+
+#include "IDocumentStyles.h"
+
+#include "HeadlessDocument.h"
+
+#include "UTF8Decode.h"
+
+using namespace Lexilla;
+
+namespace {
+
+// SC_FOLDLEVELBASE
+constexpr int levelBase = 0x400;
+constexpr int tabInChars = 8;
+
+#if _WIN32
+
+std::wstring WideStringFromUTF8(std::string_view sv) {
+	const int sLength = static_cast<int>(sv.length());
+	const int cchWide = ::MultiByteToWideChar(CP_UTF8, 0, sv.data(), sLength, nullptr, 0);
+	std::wstring sWide(cchWide, 0);
+	::MultiByteToWideChar(CP_UTF8, 0, sv.data(), sLength, sWide.data(), cchWide);
+	return sWide;
+}
+
+#endif
+
+// Append the start of each line after the first to lineStarts.
+// Lines end with LF, CR+LF or a CR not followed by LF.
+void AddLineStarts(const char *s, size_t length, std::vector<Sci_Position> &lineStarts) {
+	size_t pos = 0;
+#if HEADLESS_SSE2
+	const __m128i lf = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+	for (; pos + 16 <= length; pos += 16) {
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + pos));
+		unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, lf), _mm_cmpeq_epi8(block, cr)));
+		while (mask) {
+			unsigned int bit = 0;
+			while (!(mask & (1U << bit)))
+				bit++;
+			mask &= ~(1U << bit);
+			const size_t position = pos + bit;
+			if (s[position] == '\n' || position + 1 >= length || s[position + 1] != '\n') {
+				lineStarts.push_back(position + 1);
+			}
+		}
+	}
+#endif
+	for (; pos < length; pos++) {
+		if (s[pos] == '\n' || (s[pos] == '\r' && (pos + 1 >= length || s[pos + 1] != '\n'))) {
+			lineStarts.push_back(pos + 1);
+		}
+	}
+}
+
+}
+
+#if _MSC_VER
+// IDocument interface does not specify noexcept so best to not add it to implementation
+#pragma warning(disable: 26440)
+#endif
+
+HeadlessDocument::HeadlessDocument() {
+	Index();
+}
+
+HeadlessDocument::~HeadlessDocument() {
+	Unmap();
+}
+
+void HeadlessDocument::Unmap() noexcept {
+	if (mapping) {
+#if _WIN32
+		::UnmapViewOfFile(mapping);
+#else
+		::munmap(mapping, mappingLength);
+#endif
+		mapping = nullptr;
+		mappingLength = 0;
+	}
+}
+
+void HeadlessDocument::Index() {
+	lineStarts.clear();
+	lineStarts.push_back(0);
+	AddLineStarts(text, length, lineStarts);
+	lineStarts.push_back(length);
+	const size_t lines = lineStarts.size() - 1;
+	lineStates.assign(lines, 0);
+	lineLevels.assign(lines, levelBase);
+	styles.assign(length + 1, 0);
+	endStyled = 0;
+	lineLast = 0;
+}
+
+void HeadlessDocument::Set(std::string_view sv) {
+	Unmap();
+	ownedText = sv;
+	text = ownedText.c_str();
+	length = ownedText.length();
+	Index();
+}
+
+bool HeadlessDocument::Map(const char *path) {
+	Unmap();
+	ownedText.clear();
+	text = ownedText.c_str();
+	length = 0;
+#if _WIN32
+	const HANDLE file = ::CreateFileW(WideStringFromUTF8(path).c_str(), GENERIC_READ, FILE_SHARE_READ,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		Index();
+		return false;
+	}
+	LARGE_INTEGER size {};
+	bool success = ::GetFileSizeEx(file, &size) != 0;
+	if (success && size.QuadPart > 0) {
+		const HANDLE fileMapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (fileMapping) {
+			mapping = ::MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+			::CloseHandle(fileMapping);
+		}
+		success = mapping != nullptr;
+		if (success) {
+			mappingLength = static_cast<size_t>(size.QuadPart);
+		}
+	}
+	::CloseHandle(file);
+#else
+	const int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		Index();
+		return false;
+	}
+	struct stat st {};
+	bool success = ::fstat(fd, &st) == 0;
+	if (success && st.st_size > 0) {
+		void *view = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		success = view != MAP_FAILED;
+		if (success) {
+			mapping = view;
+			mappingLength = st.st_size;
+		}
+	}
+	::close(fd);
+#endif
+	if (mapping) {
+		text = static_cast<const char *>(mapping);
+		length = mappingLength;
+	}
+	Index();
+	return success;
+}
+
+void HeadlessDocument::SetCodePage(int codePage_) noexcept {
+	codePage = codePage_;
+}
+
+std::string_view HeadlessDocument::Text() const noexcept {
+	return std::string_view(text, length);
+}
+
+const char *HeadlessDocument::Styles() const noexcept {
+	return styles.data();
+}
+
+Sci_Position HeadlessDocument::Lines() const noexcept {
+	return LinesTotal();
+}
+
+int HeadlessDocument::ErrorStatus() const noexcept {
+	return errorStatus;
+}
+
+int SCI_METHOD HeadlessDocument::Version() const {
+	return dvStyleRange;
+}
+
+void SCI_METHOD HeadlessDocument::SetErrorStatus(int status) {
+	errorStatus = status;
+}
+
+Sci_Position SCI_METHOD HeadlessDocument::Length() const {
+	return length;
+}
+
+void SCI_METHOD HeadlessDocument::GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const {
+	if ((position < 0) || (lengthRetrieve <= 0) || (position + lengthRetrieve > length)) {
+		return;
+	}
+	memcpy(buffer, text + position, lengthRetrieve);
+}
+
+char SCI_METHOD HeadlessDocument::StyleAt(Sci_Position position) const {
+	if ((position < 0) || (position >= length)) {
+		return 0;
+	}
+	return styles[position];
+}
+
+Sci_Position SCI_METHOD HeadlessDocument::LineFromPosition(Sci_Position position) const {
+	const Sci_Position lines = LinesTotal();
+	if (position <= 0) {
+		return 0;
+	}
+	if (position >= length) {
+		return lines - 1;
+	}
+	// Lexers mostly ask about the same line or the one after it
+	if (position >= lineStarts[lineLast]) {
+		if (position < lineStarts[lineLast + 1]) {
+			return lineLast;
+		}
+		if ((lineLast + 2 <= lines) && (position < lineStarts[lineLast + 2])) {
+			return ++lineLast;
+		}
+	}
+	const std::vector<Sci_Position>::const_iterator it =
+		std::upper_bound(lineStarts.begin(), lineStarts.begin() + lines, position);
+	lineLast = (it - lineStarts.begin()) - 1;
+	return lineLast;
+}
+
+Sci_Position SCI_METHOD HeadlessDocument::LineStart(Sci_Position line) const {
+	if (line <= 0) {
+		return 0;
+	}
+	if (line >= LinesTotal()) {
+		return length;
+	}
+	return lineStarts[line];
+}
+
+int SCI_METHOD HeadlessDocument::GetLevel(Sci_Position line) const {
+	if ((line < 0) || (line >= LinesTotal())) {
+		return levelBase;
+	}
+	return lineLevels[line];
+}
+
+int SCI_METHOD HeadlessDocument::SetLevel(Sci_Position line, int level) {
+	if ((line < 0) || (line >= LinesTotal())) {
+		return levelBase;
+	}
+	const int previous = lineLevels[line];
+	lineLevels[line] = level;
+	return previous;
+}
+
+int SCI_METHOD HeadlessDocument::GetLineState(Sci_Position line) const {
+	if ((line < 0) || (line >= static_cast<Sci_Position>(lineStates.size()))) {
+		return 0;
+	}
+	return lineStates[line];
+}
+
+int SCI_METHOD HeadlessDocument::SetLineState(Sci_Position line, int state) {
+	if (line < 0) {
+		return 0;
+	}
+	// As with Scintilla, the line after the last may be given a state
+	if (line >= static_cast<Sci_Position>(lineStates.size())) {
+		lineStates.resize(line + 1);
+	}
+	const int previous = lineStates[line];
+	lineStates[line] = state;
+	return previous;
+}
+
+void SCI_METHOD HeadlessDocument::StartStyling(Sci_Position position) {
+	endStyled = std::clamp<Sci_Position>(position, 0, length);
+}
+
+bool SCI_METHOD HeadlessDocument::SetStyleFor(Sci_Position lengthStyle, char style) {
+	// Range checked once rather than for each byte
+	lengthStyle = std::clamp<Sci_Position>(lengthStyle, 0, length - endStyled);
+	memset(styles.data() + endStyled, static_cast<unsigned char>(style), lengthStyle);
+	endStyled += lengthStyle;
+	return true;
+}
+
+bool SCI_METHOD HeadlessDocument::SetStyles(Sci_Position lengthStyle, const char *stylesSet) {
+	assert(stylesSet);
+	lengthStyle = std::clamp<Sci_Position>(lengthStyle, 0, length - endStyled);
+	memcpy(styles.data() + endStyled, stylesSet, lengthStyle);
+	endStyled += lengthStyle;
+	return true;
+}
+
+void SCI_METHOD HeadlessDocument::DecorationSetCurrentIndicator(int) {
+	// Indicators are not retained
+}
+
+void SCI_METHOD HeadlessDocument::DecorationFillRange(Sci_Position, int, Sci_Position) {
+	// Indicators are not retained
+}
+
+void SCI_METHOD HeadlessDocument::ChangeLexerState(Sci_Position, Sci_Position) {
+	// No watchers to notify
+}
+
+int SCI_METHOD HeadlessDocument::CodePage() const {
+	return codePage;
+}
+
+bool SCI_METHOD HeadlessDocument::IsDBCSLeadByte(char) const {
+	// DBCS is not supported
+	return false;
+}
+
+const char *SCI_METHOD HeadlessDocument::BufferPointer() {
+	if (mapping) {
+		// A mapped file is not NUL terminated so copy it
+		ownedText.assign(text, length);
+		Unmap();
+		text = ownedText.c_str();
+	}
+	return text;
+}
+
+int SCI_METHOD HeadlessDocument::GetLineIndentation(Sci_Position line) {
+	int indent = 0;
+	const Sci_Position lineEnd = LineEnd(line);
+	for (Sci_Position position = LineStart(line); position < lineEnd; position++) {
+		if (text[position] == ' ') {
+			indent++;
+		} else if (text[position] == '\t') {
+			indent = (indent / tabInChars + 1) * tabInChars;
+		} else {
+			break;
+		}
+	}
+	return indent;
+}
+
+Sci_Position SCI_METHOD HeadlessDocument::LineEnd(Sci_Position line) const {
+	if (line >= LinesTotal() - 1) {
+		return LineStart(line + 1);
+	}
+	Sci_Position position = LineStart(line + 1) - 1;	// Back over CR or LF
+	// When line terminator is CR+LF, go back one more
+	if ((position > LineStart(line)) && (text[position] == '\n') && (text[position - 1] == '\r')) {
+		position--;
+	}
+	return position;
+}
+
+// Same as Scintilla's Document::NextPosition for UTF-8 and single byte encodings.
+Sci_Position HeadlessDocument::NextPosition(Sci_Position position, int moveDir) const noexcept {
+	const int increment = (moveDir > 0) ? 1 : -1;
+	if (position + increment <= 0)
+		return 0;
+	if (position + increment >= length)
+		return length;
+	if (codePage != 65001)
+		return position + increment;
+	if (increment == 1) {
+		Sci_Position width = 1;
+		GetCharacterAndWidth(position, &width);
+		return position + width;
+	}
+	// Examine byte before position
+	position--;
+	if (UTF8IsTrailByte(text[position])) {
+		// If a trail byte in a valid UTF-8 character then return start of character
+		Sci_Position trail = position;
+		while ((trail > 0) && (position - trail < 4) && UTF8IsTrailByte(text[trail - 1]))
+			trail--;
+		const Sci_Position start = (trail > 0) ? trail - 1 : trail;
+		Sci_Position width = 1;
+		GetCharacterAndWidth(start, &width);
+		if (start + width > position) {
+			position = start;
+		}
+	}
+	return position;
+}
+
+Sci_Position SCI_METHOD HeadlessDocument::GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const {
+	Sci_Position pos = positionStart;
+	const int increment = (characterOffset > 0) ? 1 : -1;
+	while (characterOffset != 0) {
+		const Sci_Position posNext = NextPosition(pos, increment);
+		if (posNext == pos)
+			return -1;	// INVALID_POSITION
+		pos = posNext;
+		characterOffset -= increment;
+	}
+	return pos;
+}
+
+int SCI_METHOD HeadlessDocument::GetCharacterAndWidth(Sci_Position position, Sci_Position *pWidth) const {
+	if (pWidth) {
+		*pWidth = 1;
+	}
+	if ((position < 0) || (position >= length)) {
+		// NULs outside document
+		return 0;
+	}
+	const unsigned char leadByte = text[position];
+	if ((codePage != 65001) || (leadByte < 0x80)) {
+		return leadByte;
+	}
+	const int widthCharBytes = UTF8BytesOfLead(leadByte);
+	unsigned char charBytes[4] = { leadByte, 0, 0, 0 };
+	for (int b = 1; (b < widthCharBytes) && (position + b < length); b++) {
+		charBytes[b] = text[position + b];
+	}
+	const int widthValid = UTF8ValidWidth(charBytes, widthCharBytes);
+	if (!widthValid) {
+		// Report as singleton surrogate values which are invalid Unicode
+		return 0xDC80 + leadByte;
+	}
+	if (pWidth) {
+		*pWidth = widthValid;
+	}
+	return UnicodeFromUTF8(charBytes, widthValid);
+}
+
+void SCI_METHOD HeadlessDocument::GetStyleRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const {
+	if ((position < 0) || (lengthRetrieve <= 0) || (position + lengthRetrieve > length)) {
+		return;
+	}
+	memcpy(buffer, styles.data() + position, lengthRetrieve);
+}
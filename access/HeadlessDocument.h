@@ -0,0 +1,91 @@
+// Lexilla lexer library
+/** @file HeadlessDocument.h
+ ** Document for running lexers without Scintilla.
+ ** This does not depend on Scintilla or SciTE code so can be copied out into other projects.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef HEADLESSDOCUMENT_H
+#define HEADLESSDOCUMENT_H
+
+namespace Lexilla {
+
+// Implements IDocument over a read-only text that is either copied in or memory-mapped
+// from a file, so an application can call lexers directly then read back styles and folds.
+// Lines end with CR, LF or CR+LF as in Scintilla. Supports UTF-8 and single byte encodings.
+// Styles can be read in bulk through IDocumentStyles.
+// Not thread-safe: LineFromPosition caches the last line found.
+class HeadlessDocument : public IDocumentStyles {
+	std::string ownedText;
+	const char *text = "";
+	Sci_Position length = 0;
+	void *mapping = nullptr;
+	size_t mappingLength = 0;
+	int codePage = 65001;
+	int errorStatus = 0;
+	// Start of each line followed by length so there is always a next line start
+	std::vector<Sci_Position> lineStarts;
+	std::vector<int> lineStates;
+	std::vector<int> lineLevels;
+	std::vector<char> styles;
+	Sci_Position endStyled = 0;
+	mutable Sci_Position lineLast = 0;
+
+	void Unmap() noexcept;
+	void Index();
+	Sci_Position LinesTotal() const noexcept {
+		return static_cast<Sci_Position>(lineStarts.size()) - 1;
+	}
+	Sci_Position NextPosition(Sci_Position position, int moveDir) const noexcept;
+public:
+	HeadlessDocument();
+	// Deleted so HeadlessDocument objects can not be copied.
+	HeadlessDocument(const HeadlessDocument &) = delete;
+	HeadlessDocument(HeadlessDocument &&) = delete;
+	HeadlessDocument &operator=(const HeadlessDocument &) = delete;
+	HeadlessDocument &operator=(HeadlessDocument &&) = delete;
+	virtual ~HeadlessDocument();
+
+	// Copy text into the document, resetting styles, line states and fold levels.
+	void Set(std::string_view sv);
+	// Map the file at path (UTF-8 on Windows) read-only. Returns false if it could not be mapped.
+	bool Map(const char *path);
+	// 65001 for UTF-8 or 0 for a single byte encoding.
+	void SetCodePage(int codePage_) noexcept;
+
+	std::string_view Text() const noexcept;
+	const char *Styles() const noexcept;
+	Sci_Position Lines() const noexcept;
+	int ErrorStatus() const noexcept;
+
+	int SCI_METHOD Version() const override;
+	void SCI_METHOD SetErrorStatus(int status) override;
+	Sci_Position SCI_METHOD Length() const override;
+	void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const override;
+	char SCI_METHOD StyleAt(Sci_Position position) const override;
+	Sci_Position SCI_METHOD LineFromPosition(Sci_Position position) const override;
+	Sci_Position SCI_METHOD LineStart(Sci_Position line) const override;
+	int SCI_METHOD GetLevel(Sci_Position line) const override;
+	int SCI_METHOD SetLevel(Sci_Position line, int level) override;
+	int SCI_METHOD GetLineState(Sci_Position line) const override;
+	int SCI_METHOD SetLineState(Sci_Position line, int state) override;
+	void SCI_METHOD StartStyling(Sci_Position position) override;
+	bool SCI_METHOD SetStyleFor(Sci_Position lengthStyle, char style) override;
+	bool SCI_METHOD SetStyles(Sci_Position lengthStyle, const char *stylesSet) override;
+	void SCI_METHOD DecorationSetCurrentIndicator(int indicator) override;
+	void SCI_METHOD DecorationFillRange(Sci_Position position, int value, Sci_Position fillLength) override;
+	void SCI_METHOD ChangeLexerState(Sci_Position start, Sci_Position end) override;
+	int SCI_METHOD CodePage() const override;
+	bool SCI_METHOD IsDBCSLeadByte(char ch) const override;
+	const char *SCI_METHOD BufferPointer() override;
+	int SCI_METHOD GetLineIndentation(Sci_Position line) override;
+	Sci_Position SCI_METHOD LineEnd(Sci_Position line) const override;
+	Sci_Position SCI_METHOD GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const override;
+	int SCI_METHOD GetCharacterAndWidth(Sci_Position position, Sci_Position *pWidth) const override;
+
+	void SCI_METHOD GetStyleRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const override;
+};
+
+}
+
+#endif
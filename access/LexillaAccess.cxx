@@ -14,6 +14,7 @@
 #include <string_view>
 #include <vector>
 #include <set>
+#include <map>
 
 #if !_WIN32
 #include <dlfcn.h>
@@ -77,6 +78,7 @@ struct LexLibrary {
 	Lexilla::LexerNameFromIDFn fnLNFI;
 	Lexilla::GetLibraryPropertyNamesFn fnGLPN;
 	Lexilla::SetLibraryPropertyFn fnSLP;
+	Lexilla::CloneLexerFn fnCLL;
 	std::string nameSpace;
 };
 std::vector<LexLibrary> libraries;
@@ -84,6 +86,18 @@ std::vector<LexLibrary> libraries;
 std::vector<std::string> lexers;
 std::vector<std::string> libraryProperties;
 
+// CloneLexer function of the library that made each lexer so lexers are only passed
+// back to the library that understands them.
+// Entries for released lexers remain until their address is reused by a new lexer.
+std::map<Scintilla::ILexer5 *, Lexilla::CloneLexerFn> cloners;
+
+Scintilla::ILexer5 *Remember(Scintilla::ILexer5 *pLexer, Lexilla::CloneLexerFn fnCLL) {
+	if (pLexer) {
+		cloners[pLexer] = fnCLL;
+	}
+	return pLexer;
+}
+
 Function FindSymbol(Module m, const char *symbol) noexcept {
 #if _WIN32
 	return ::GetProcAddress(m, symbol);
@@ -128,6 +142,7 @@ bool Lexilla::Load(std::string_view sharedLibraryPaths) {
 	lexers.clear();
 
 	libraries.clear();
+	cloners.clear();
 	while (!paths.empty()) {
 		const size_t separator = paths.find_first_of(';');
 		std::string path(paths.substr(0, separator));
@@ -177,6 +192,8 @@ bool Lexilla::Load(std::string_view sharedLibraryPaths) {
 				FindSymbol(lexillaDL, LEXILLA_GETLIBRARYPROPERTYNAMES));
 			SetLibraryPropertyFn fnSLP = FunctionPointer<SetLibraryPropertyFn>(
 				FindSymbol(lexillaDL, LEXILLA_SETLIBRARYPROPERTY));
+			CloneLexerFn fnCLL = FunctionPointer<CloneLexerFn>(
+				FindSymbol(lexillaDL, LEXILLA_CLONELEXER));
 			GetNameSpaceFn fnGNS = FunctionPointer<GetNameSpaceFn>(
 				FindSymbol(lexillaDL, LEXILLA_GETNAMESPACE));
 			std::string nameSpace;
@@ -189,6 +206,7 @@ bool Lexilla::Load(std::string_view sharedLibraryPaths) {
 				fnLNFI,
 				fnGLPN,
 				fnSLP,
+				fnCLL,
 				nameSpace
 			};
 			libraries.push_back(lexLib);
@@ -229,7 +247,7 @@ Scintilla::ILexer5 *Lexilla::MakeLexer(std::string_view languageName) {
 			if (HasPrefix(languageName, lexLib.nameSpace)) {
 				Scintilla::ILexer5 *pLexer = lexLib.fnCL(sLanguageName.substr(lexLib.nameSpace.size()).c_str());
 				if (pLexer) {
-					return pLexer;
+					return Remember(pLexer, lexLib.fnCLL);
 				}
 			}
 		}
@@ -239,22 +257,33 @@ Scintilla::ILexer5 *Lexilla::MakeLexer(std::string_view languageName) {
 		if (lexLib.fnCL) {
 			Scintilla::ILexer5 *pLexer = lexLib.fnCL(sLanguageName.c_str());
 			if (pLexer) {
-				return pLexer;
+				return Remember(pLexer, lexLib.fnCLL);
 			}
 		}
 	}
 	if (pCreateLexerDefault) {
-		return pCreateLexerDefault(sLanguageName.c_str());
+		// No way to clone lexers made by an unknown function
+		return Remember(pCreateLexerDefault(sLanguageName.c_str()), nullptr);
 	}
 #ifdef LEXILLA_STATIC
 	Scintilla::ILexer5 *pLexer = CreateLexer(sLanguageName.c_str());
 	if (pLexer) {
-		return pLexer;
+		return Remember(pLexer, ::CloneLexer);
 	}
 #endif
 	return nullptr;
 }
 
+Scintilla::ILexer5 *Lexilla::CloneLexer(Scintilla::ILexer5 *prototype) {
+	// Only the library that made prototype is asked to clone it
+	const auto it = cloners.find(prototype);
+	if ((it == cloners.end()) || !it->second) {
+		return nullptr;
+	}
+	const Lexilla::CloneLexerFn fnCLL = it->second;
+	return Remember(fnCLL(prototype), fnCLL);
+}
+
 std::vector<std::string> Lexilla::Lexers() {
 	return lexers;
 }
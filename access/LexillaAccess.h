@@ -24,6 +24,9 @@ void SetDefault(CreateLexerFn pCreate) noexcept;
 bool Load(std::string_view sharedLibraryPaths);
 
 Scintilla::ILexer5 *MakeLexer(std::string_view languageName);
+// Returns a lexer that shares the configuration of prototype or nullptr if the lexer can not be cloned.
+// prototype must have been made by MakeLexer or CloneLexer and only the library that made it is asked.
+Scintilla::ILexer5 *CloneLexer(Scintilla::ILexer5 *prototype);
 
 std::vector<std::string> Lexers();
 [[deprecated]] std::string NameFromID(int identifier);
@@ -0,0 +1,33 @@
+// Lexilla lexer library
+/** @file IDocumentStyles.h
+ ** Optional extension to Scintilla::IDocument for reading styles in bulk.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef IDOCUMENTSTYLES_H
+#define IDOCUMENTSTYLES_H
+
+// Must have already included ILexer.h to have Scintilla::IDocument defined.
+
+namespace Lexilla {
+
+// Documents implementing IDocumentStyles return exactly this value from Version().
+// LexAccessor only treats a document as an IDocumentStyles when Version() is equal to it,
+// so a host returning any other value, including one with extra bits set, is never cast.
+// Scintilla's document versions count up from dvRelease4 so this value, with "LX" in the
+// high half, can not be reached by them. A new Scintilla document version that includes
+// GetStyleRange would replace this value.
+constexpr int dvStyleRange = 0x4C580002;
+
+// Lexers and folders read styles through a window filled from GetStyleRange
+// instead of calling StyleAt for each position. Implementations must also provide
+// everything Scintilla::IDocument provides at dvRelease4.
+class IDocumentStyles : public Scintilla::IDocument {
+public:
+	// Copy the styles of lengthRetrieve positions starting at position, which are all within the document.
+	virtual void SCI_METHOD GetStyleRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const = 0;
+};
+
+}
+
+#endif
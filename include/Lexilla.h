@@ -62,6 +62,7 @@ DEPRECATE_DEFINITION typedef const char *(LEXILLA_CALL *LexerNameFromIDFn)(int i
 typedef const char *(LEXILLA_CALL *GetLibraryPropertyNamesFn)();
 typedef void(LEXILLA_CALL *SetLibraryPropertyFn)(const char *key, const char *value);
 typedef const char *(LEXILLA_CALL *GetNameSpaceFn)();
+typedef ILexer5*(LEXILLA_CALL *CloneLexerFn)(ILexer5 *prototype);
 
 #ifdef __cplusplus
 }
@@ -77,6 +78,7 @@ typedef const char *(LEXILLA_CALL *GetNameSpaceFn)();
 #define LEXILLA_GETLIBRARYPROPERTYNAMES "GetLibraryPropertyNames"
 #define LEXILLA_SETLIBRARYPROPERTY "SetLibraryProperty"
 #define LEXILLA_GETNAMESPACE "GetNameSpace"
+#define LEXILLA_CLONELEXER "CloneLexer"
 
 // Static linking prototypes
 
@@ -92,6 +94,7 @@ DEPRECATE_DEFINITION const char *LEXILLA_CALL LexerNameFromID(int identifier);
 const char * LEXILLA_CALL GetLibraryPropertyNames();
 void LEXILLA_CALL SetLibraryProperty(const char *key, const char *value);
 const char *LEXILLA_CALL GetNameSpace();
+ILexer5 * LEXILLA_CALL CloneLexer(ILexer5 *prototype);
 
 #ifdef __cplusplus
 }
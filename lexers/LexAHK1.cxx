@@ -9,6 +9,7 @@
  **  - Fix expression lines starting with ( as being misdetected as continuation sections
  **  - Add ;{ and ;} section folding support
  **  - Highlight all brace types as "expression operators"
+ **  - Port to an object lexer that saves per-line state
  **/
 // Copyright 1998-2012 by Neil Hodgson <neilh@scintilla.org>
 // The License.txt file describes the conditions under which this software may be distributed.
@@ -20,31 +21,87 @@
 #include <stdarg.h>
 #include <assert.h>
 
-#ifdef _MSC_VER
-#pragma warning(disable: 4786)
-#endif
-
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <functional>
 
 #include "ILexer.h"
 #include "Scintilla.h"
 #include "SciLexer.h"
 
-#include "PropSetSimple.h"
 #include "WordList.h"
 #include "LexAccessor.h"
-#include "Accessor.h"
 #include "StyleContext.h"
 #include "CharacterSet.h"
 #include "LexerModule.h"
 #include "OptionSet.h"
+#include "DefaultLexer.h"
+#include "AHKKeyNames.h"
 
+using namespace Scintilla;
 using namespace Lexilla;
 
-static inline bool IsAWordChar(const int ch) {
+namespace {
+
+struct OptionsAHK1 {
+	bool fold = false;
+	bool foldComment = false;
+	bool foldCompact = true;
+};
+
+const char * const ahkWordListDesc[] = {
+	"Flow of control",
+	"Commands",
+	"Functions",
+	"Directives",
+	"Keys & buttons",
+	"Variables",
+	"Special Parameters (keywords)",
+	"User defined",
+	nullptr
+};
+
+struct OptionSetAHK1 final : public OptionSet<OptionsAHK1> {
+	OptionSetAHK1() {
+		DefineWordListSets(ahkWordListDesc);
+
+		DefineProperty("fold", &OptionsAHK1::fold);
+
+		DefineProperty("fold.compact", &OptionsAHK1::foldCompact);
+
+		DefineProperty("fold.comment", &OptionsAHK1::foldComment,
+			"This option enables folding multi-line comments and explicit fold points when using the AutoHotkey v1 lexer."
+			" Explicit fold points allows adding extra folding by placing a ;{ comment at the start and a ;}"
+			" at the end of a section that should fold.");
+	}
+};
+
+// One bit for each keyword list, in the order of ahkWordListDesc
+enum {
+	KeywordClass_ControlFlow   = 1U << 0,
+	KeywordClass_Commands      = 1U << 1,
+	KeywordClass_Functions     = 1U << 2,
+	KeywordClass_Directives    = 1U << 3,
+	KeywordClass_KeysButtons   = 1U << 4,
+	KeywordClass_Variables     = 1U << 5,
+	KeywordClass_SpecialParams = 1U << 6,
+	KeywordClass_UserDefined   = 1U << 7,
+};
+
+constexpr int numWordLists = 8;
+
+// State carried over from the end of one line to the start of the next,
+// stored with SetLineState so that lexing may restart on any line.
+enum {
+	LineState_ContSection  = 1U << 0,
+	LineState_ExprString   = 1U << 1,
+	LineState_CommentBlock = 1U << 2,
+};
+
+inline bool IsAWordChar(const int ch) {
 	return ch >= 0x80 || (isascii(ch) && isalnum(ch)) ||
 			ch == '_' || ch == '$' || //ch == '[' || ch == ']' || // fincs-edit
 			ch == '#' || ch == '@'; //|| ch == '?'; // fincs-edit
@@ -52,7 +109,7 @@ static inline bool IsAWordChar(const int ch) {
 
 // Expression operator
 // ( ) + - * ** / // ! ~ ^ & << >> . < > <= >= = == != <> && || [ ] ? :
-static inline bool IsExpOperator(const int ch) {
+inline bool IsExpOperator(const int ch) {
 	if (ch >= 0x80 || (isascii(ch) && isalnum(ch)))	// Fast exit
 		return false;
 	return ch == '+' || ch == '-' || ch == '*' || ch == '/' ||
@@ -62,70 +119,175 @@ static inline bool IsExpOperator(const int ch) {
 			ch == '[' || ch == ']' || ch == '?' || ch == ':'; // fincs-edit
 }
 
-static void HighlightKeyword(
-	char currentWord[],
-	StyleContext &sc,
-	WordList *keywordlists[],
-	Accessor &styler) {
+bool LineHasChar(LexAccessor &styler, Sci_PositionU pos, int ch) {
+	for (;;) {
+		const int c = styler.SafeGetCharAt(pos++, 0);
+		if (c == 0 || c == '\r' || c == '\n')
+			return false;
+		if (c == ch)
+			return true;
+	}
+}
+
+// Is the hotstring starting at pos given the X option in :options:trigger::?
+bool HotstringExecutes(LexAccessor &styler, Sci_PositionU pos) {
+	while (IsASpaceOrTab(styler.SafeGetCharAt(pos, 0)))
+		pos++;
+	if (styler.SafeGetCharAt(pos++, 0) != ':')
+		return false;
+	for (;;) {
+		const int c = styler.SafeGetCharAt(pos++, 0);
+		if (c == 'x' || c == 'X')
+			return true;
+		if (c == ':' || c == 0 || c == '\r' || c == '\n')
+			return false;
+	}
+}
+
+bool LineOpensSection(LexAccessor &styler, Sci_PositionU pos) {
+	while (IsASpaceOrTab(styler.SafeGetCharAt(pos, 0)))
+		pos++;
+	return styler.SafeGetCharAt(pos, 0) == '(' && !LineHasChar(styler, pos, ')');
+}
+
+}
+
+class LexerAHK1 final : public DefaultLexer {
+	OptionsAHK1 options;
+	OptionSetAHK1 osAHK1;
+	WordList keywordLists[numWordLists];
+	// Every exact word from all the keyword lists mapped to the set of lists it appears in,
+	// so that classifying an identifier is a single lookup instead of one per list.
+	std::map<std::string, unsigned, std::less<>> keywordClasses;
+	// Lists containing '^' prefix entries which can not be held in keywordClasses
+	unsigned prefixClasses = 0;
+
+	void BuildKeywordClasses();
+	unsigned ClassesOf(std::string_view word) const;
+	void HighlightKeyword(const char *currentWord, StyleContext &sc) const;
+
+public:
+	LexerAHK1() :
+		DefaultLexer("ahk1", SCLEX_AHK1) {
+	}
+	~LexerAHK1() override {
+	}
+	const char * SCI_METHOD PropertyNames() override {
+		return osAHK1.PropertyNames();
+	}
+	int SCI_METHOD PropertyType(const char *name) override {
+		return osAHK1.PropertyType(name);
+	}
+	const char * SCI_METHOD DescribeProperty(const char *name) override {
+		return osAHK1.DescribeProperty(name);
+	}
+	Sci_Position SCI_METHOD PropertySet(const char *key, const char *val) override;
+	const char * SCI_METHOD PropertyGet(const char *key) override {
+		return osAHK1.PropertyGet(key);
+	}
+	const char * SCI_METHOD DescribeWordListSets() override {
+		return osAHK1.DescribeWordListSets();
+	}
+	Sci_Position SCI_METHOD WordListSet(int n, const char *wl) override;
+	void SCI_METHOD Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
+	void SCI_METHOD Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
+
+	static ILexer5 *LexerFactoryAHK1() {
+		return new LexerAHK1();
+	}
+};
+
+Sci_Position SCI_METHOD LexerAHK1::PropertySet(const char *key, const char *val) {
+	if (osAHK1.PropertySet(&options, key, val)) {
+		return 0;
+	}
+	return -1;
+}
+
+Sci_Position SCI_METHOD LexerAHK1::WordListSet(int n, const char *wl) {
+	if (n < 0 || n >= numWordLists) {
+		return -1;
+	}
+	if (!keywordLists[n].Set(wl)) {
+		return -1;
+	}
+	BuildKeywordClasses();
+	return 0;
+}
 
-	(void)styler;
+void LexerAHK1::BuildKeywordClasses() {
+	keywordClasses.clear();
+	prefixClasses = 0;
+	for (int n = 0; n < numWordLists; n++) {
+		const unsigned keywordClass = 1U << n;
+		const WordList &wl = keywordLists[n];
+		for (int i = 0; i < wl.Length(); i++) {
+			const char *word = wl.WordAt(i);
+			if (word[0] == '^') {
+				prefixClasses |= keywordClass;
+			} else {
+				keywordClasses[word] |= keywordClass;
+			}
+		}
+	}
+}
 
-	WordList &controlFlow = *keywordlists[0];
-	WordList &commands = *keywordlists[1];
-	WordList &functions = *keywordlists[2];
-	WordList &directives = *keywordlists[3];
-	WordList &keysButtons = *keywordlists[4];
-	WordList &variables = *keywordlists[5];
-	WordList &specialParams = *keywordlists[6];
-	WordList &userDefined = *keywordlists[7];
+unsigned LexerAHK1::ClassesOf(std::string_view word) const {
+	unsigned classes = 0;
+	const auto it = keywordClasses.find(word);
+	if (it != keywordClasses.end()) {
+		classes = it->second;
+	}
+	if (prefixClasses) {
+		// Rare: only consult the lists holding prefix entries
+		const std::string s(word);
+		for (int n = 0; n < numWordLists; n++) {
+			const unsigned keywordClass = 1U << n;
+			if ((prefixClasses & keywordClass) && keywordLists[n].InList(s.c_str())) {
+				classes |= keywordClass;
+			}
+		}
+	}
+	return classes;
+}
 
-	if (controlFlow.InList(currentWord)) {
+void LexerAHK1::HighlightKeyword(const char *currentWord, StyleContext &sc) const {
+	const unsigned classes = ClassesOf(currentWord);
+	if (classes & KeywordClass_ControlFlow) {
 		sc.ChangeState(SCE_AHK1_WORD_CF);
-	} else if (sc.ch != '(' && commands.InList(currentWord)) {
+	} else if (sc.ch != '(' && (classes & KeywordClass_Commands)) {
 		sc.ChangeState(SCE_AHK1_WORD_CMD);
-	} else if (sc.ch == '(' && functions.InList(currentWord)) {
+	} else if (sc.ch == '(' && (classes & KeywordClass_Functions)) {
 		sc.ChangeState(SCE_AHK1_WORD_FN);
-	}  else if (currentWord[0] == '#' && directives.InList(currentWord + 1)) {
+	}  else if (currentWord[0] == '#' && (ClassesOf(currentWord + 1) & KeywordClass_Directives)) {
 		sc.ChangeState(SCE_AHK1_WORD_DIR);
-	} else if (keysButtons.InList(currentWord)) {
+	} else if (classes & KeywordClass_KeysButtons) {
 		sc.ChangeState(SCE_AHK1_WORD_KB);
-	} else if (variables.InList(currentWord)) {
+	} else if (classes & KeywordClass_Variables) {
 		sc.ChangeState(SCE_AHK1_WORD_VAR);
-	} else if (specialParams.InList(currentWord)) {
+	} else if (classes & KeywordClass_SpecialParams) {
 		sc.ChangeState(SCE_AHK1_WORD_SP);
-	} else if (userDefined.InList(currentWord)) {
+	} else if (classes & KeywordClass_UserDefined) {
 		sc.ChangeState(SCE_AHK1_WORD_UD);
 	} else {
 		sc.ChangeState(SCE_AHK1_DEFAULT);
 	}
 }
 
-static bool LineHasChar(Accessor &styler, size_t pos, int ch)
-{
-	for (;;)
-	{
-		int c = styler.SafeGetCharAt(pos++, 0);
-		if (c == 0 || c == '\r' || c == '\n')
-			return false;
-		if (c == ch)
-			return true;
-	}
-}
-
-static void ColouriseAHK1Doc(
-	Sci_PositionU startPos,
-	Sci_Position length,
-	int initStyle,
-	WordList *keywordlists[],
-	Accessor &styler) {
-
-	WordList &keysButtons = *keywordlists[4];
-	WordList &variables = *keywordlists[5];
+void SCI_METHOD LexerAHK1::Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
+	LexAccessor styler(pAccess);
 	char currentWord[256];
 
-	// Do not leak onto next line
-	if (initStyle != SCE_AHK1_COMMENTBLOCK &&
-			initStyle != SCE_AHK1_STRING) {
+	// Restore the state at the end of the previous line instead of inferring it
+	// from the style of the previous character.
+	const Sci_Position lineStart = styler.GetLine(startPos);
+	const int lineState = (lineStart > 0) ? styler.GetLineState(lineStart - 1) : 0;
+	if (lineState & LineState_CommentBlock) {
+		initStyle = SCE_AHK1_COMMENTBLOCK;
+	} else if (lineState & LineState_ContSection) {
+		initStyle = SCE_AHK1_STRING;
+	} else {
+		// Do not leak onto next line
 		initStyle = SCE_AHK1_DEFAULT;
 	}
 	int currentState = initStyle;
@@ -137,7 +299,7 @@ static void ColouriseAHK1Doc(
 	I won't go this far, but I will try to handle most regular cases.
 	*/
 	// True if in a continuation section
-	bool bContinuationSection = (initStyle == SCE_AHK1_STRING);
+	bool bContinuationSection = (lineState & LineState_ContSection) != 0;
 	// Indicate if the lexer has seen only spaces since the start of the line
 	bool bOnlySpaces = (!bContinuationSection);
 	// Indicate if since the start of the line, lexer met only legal label chars
@@ -148,13 +310,27 @@ static void ColouriseAHK1Doc(
 	// In an expression
 	bool bInExpression = false;
 	// A quoted string in an expression (share state with continuation section string)
-	bool bInExprString = false;
+	bool bInExprString = (lineState & LineState_ExprString) != 0;
 	// To accept A-F chars in a number
 	bool bInHexNumber = false;
 
 	StyleContext sc(startPos, length, initStyle, styler);
 
-	for (; sc.More(); sc.Forward()) {
+	auto moveForward = [&] {
+		if (sc.atLineEnd) {
+			int lineStateNext = 0;
+			if (bContinuationSection)
+				lineStateNext |= LineState_ContSection;
+			if (bInExprString)
+				lineStateNext |= LineState_ExprString;
+			if (sc.state == SCE_AHK1_COMMENTBLOCK)
+				lineStateNext |= LineState_CommentBlock;
+			styler.SetLineState(sc.currentLine, lineStateNext);
+		}
+		sc.Forward();
+	};
+
+	for (; sc.More(); moveForward()) {
 		if (nextState >= 0) {
 			// I need to reset a state before checking new char
 			sc.SetState(nextState);
@@ -164,7 +340,7 @@ static void ColouriseAHK1Doc(
 			// Only one char (if two detected, we move Forward() anyway)
 			sc.SetState(SCE_AHK1_DEFAULT);
 		}
-		if (sc.atLineEnd && (bIsHotkey || bIsHotstring)) {
+		if (sc.MatchLineEnd() && (bIsHotkey || bIsHotstring)) {
 			// I make the hotkeys and hotstrings more visible
 			// by changing the line end to LABEL style (if style uses eolfilled)
 			bIsHotkey = bIsHotstring = false;
@@ -175,6 +351,13 @@ static void ColouriseAHK1Doc(
 					!bContinuationSection) {
 				// Prevent some styles from leaking back to previous line
 				sc.SetState(SCE_AHK1_DEFAULT);
+				if (bInExprString && !LineOpensSection(styler, sc.currentPos)) {
+					// An unterminated string only carries on into a continuation section
+					bInExprString = false;
+				}
+			} else if (bContinuationSection && sc.state == SCE_AHK1_ERROR) {
+				// An illegal character only spoils its own line of the section
+				sc.SetState(SCE_AHK1_STRING);
 			}
 			bOnlySpaces = true;
 			bIsLabel = false;
@@ -248,13 +431,19 @@ static void ColouriseAHK1Doc(
 					bIsHotkey = true;
 					// Check if it is a known key
 					sc.GetCurrentLowered(currentWord, sizeof(currentWord));
-					if (keysButtons.InList(currentWord)) {
+					if (IsAHKKeyName(currentWord) || (ClassesOf(currentWord) & KeywordClass_KeysButtons)) {
 						sc.ChangeState(SCE_AHK1_WORD_KB);
 					}
 					sc.SetState(SCE_AHK1_SYNOPERATOR);
 					sc.Forward();
 					if (bIsHotstring) {
-						nextState = SCE_AHK1_STRING;
+						if (HotstringExecutes(styler, styler.LineStart(sc.currentLine))) {
+							// The X option makes the replacement a command or expression
+							bIsHotstring = false;
+							nextState = SCE_AHK1_DEFAULT;
+						} else {
+							nextState = SCE_AHK1_STRING;
+						}
 					}
 					continue;
 				}
@@ -270,14 +459,14 @@ static void ColouriseAHK1Doc(
 
 		// Determine if the current state should terminate.
 		if (sc.state == SCE_AHK1_COMMENTLINE) {
-			if (sc.atLineEnd) {
+			if (sc.MatchLineEnd()) {
 				sc.SetState(SCE_AHK1_DEFAULT);
 			}
 		} else if (sc.state == SCE_AHK1_COMMENTBLOCK) {
 			if (bOnlySpaces && sc.Match('*', '/')) {
 				// End of comment at start of line (skipping white space)
 				sc.Forward();
-				sc.ForwardSetState(SCE_C_DEFAULT);
+				sc.ForwardSetState(SCE_AHK1_DEFAULT);
 			}
 		} else if (sc.state == SCE_AHK1_EXPOPERATOR) {
 			if (!IsExpOperator(sc.ch)) {
@@ -289,6 +478,10 @@ static void ColouriseAHK1Doc(
 					// End of continuation section
 					bContinuationSection = false;
 					sc.SetState(SCE_AHK1_EXPOPERATOR);
+					if (bInExprString) {
+						// The string started before the section is closed after it
+						nextState = SCE_AHK1_STRING;
+					}
 				}
 			} else if (bInExprString) {
 				if (sc.ch == '\"') {
@@ -320,7 +513,7 @@ static void ColouriseAHK1Doc(
 		} else if (sc.state == SCE_AHK1_IDENTIFIER) {
 			if (!IsAWordChar(sc.ch)) {
 				sc.GetCurrentLowered(currentWord, sizeof(currentWord));
-				HighlightKeyword(currentWord, sc, keywordlists, styler);
+				HighlightKeyword(currentWord, sc);
 				if (strcmp(currentWord, "if") == 0) {
 					bInExpression = true;
 				}
@@ -330,7 +523,7 @@ static void ColouriseAHK1Doc(
 			if (sc.ch == '%') {
 				// End of variable reference
 				sc.GetCurrentLowered(currentWord, sizeof(currentWord));
-				if (variables.InList(currentWord)) {
+				if (ClassesOf(currentWord) & KeywordClass_Variables) {
 					sc.ChangeState(SCE_AHK1_VARREFKW);
 				}
 				sc.SetState(SCE_AHK1_SYNOPERATOR);
@@ -380,7 +573,8 @@ static void ColouriseAHK1Doc(
 				sc.SetState(SCE_AHK1_SYNOPERATOR);
 				sc.Forward();
 				nextState = SCE_AHK1_DEFAULT;
-			} else if (IsExpOperator(sc.ch)) {
+			} else if (IsExpOperator(sc.ch) && !(bOnlySpaces && sc.ch == ':')) {
+				// A colon starting the line opens hotstring options below
 				sc.SetState(SCE_AHK1_EXPOPERATOR);
 			} else if (sc.ch == '\"') {
 				bInExprString = true;
@@ -418,8 +612,8 @@ static void ColouriseAHK1Doc(
 	// End of file: complete any pending changeState
 	if (sc.state == SCE_AHK1_IDENTIFIER) {
 		sc.GetCurrentLowered(currentWord, sizeof(currentWord));
-		HighlightKeyword(currentWord, sc, keywordlists, styler);
-	} else if (sc.state == SCE_AHK1_STRING && bInExprString) {
+		HighlightKeyword(currentWord, sc);
+	} else if (sc.state == SCE_AHK1_STRING && bInExprString && !bContinuationSection) {
 		sc.ChangeState(SCE_AHK1_ERROR);
 	} else if (sc.state == SCE_AHK1_VARREF) {
 		sc.ChangeState(SCE_AHK1_ERROR);
@@ -427,13 +621,16 @@ static void ColouriseAHK1Doc(
 	sc.Complete();
 }
 
-static void FoldAHK1Doc(Sci_PositionU startPos, Sci_Position length, int initStyle,
-                            WordList *[], Accessor &styler) {
-	bool foldComment = styler.GetPropertyInt("fold.comment") != 0;
-	bool foldCompact = styler.GetPropertyInt("fold.compact", 1) != 0;
-	Sci_PositionU endPos = startPos + length;
+void SCI_METHOD LexerAHK1::Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
+	if (!options.fold)
+		return;
+
+	LexAccessor styler(pAccess);
+	const bool foldComment = options.foldComment;
+	const bool foldCompact = options.foldCompact;
+	const Sci_PositionU endPos = startPos + length;
 	bool bOnlySpaces = true;
-	int lineCurrent = styler.GetLine(startPos);
+	Sci_Position lineCurrent = styler.GetLine(startPos);
 	int levelCurrent = SC_FOLDLEVELBASE;
 	if (lineCurrent > 0) {
 		levelCurrent = styler.LevelAt(lineCurrent - 1) >> 16;
@@ -443,12 +640,12 @@ static void FoldAHK1Doc(Sci_PositionU startPos, Sci_Position length, int initSty
 	int styleNext = styler.StyleAt(startPos);
 	int style = initStyle;
 	for (Sci_PositionU i = startPos; i < endPos; i++) {
-		char ch = chNext;
+		const char ch = chNext;
 		chNext = styler.SafeGetCharAt(i + 1);
-		int stylePrev = style;
+		const int stylePrev = style;
 		style = styleNext;
 		styleNext = styler.StyleAt(i + 1);
-		bool atEOL = (ch == '\r' && chNext != '\n') || (ch == '\n');
+		const bool atEOL = (ch == '\r' && chNext != '\n') || (ch == '\n');
 		if (foldComment && style == SCE_AHK1_COMMENTBLOCK) {
 			if (stylePrev != SCE_AHK1_COMMENTBLOCK) {
 				levelNext++;
@@ -499,16 +696,4 @@ static void FoldAHK1Doc(Sci_PositionU startPos, Sci_Position length, int initSty
 	}
 }
 
-static const char * const ahkWordListDesc[] = {
-	"Flow of control",
-	"Commands",
-	"Functions",
-	"Directives",
-	"Keys & buttons",
-	"Variables",
-	"Special Parameters (keywords)",
-	"User defined",
-	0
-};
-
-LexerModule lmAHK1(SCLEX_AHK1, ColouriseAHK1Doc, "ahk1", FoldAHK1Doc, ahkWordListDesc);
+LexerModule lmAHK1(SCLEX_AHK1, LexerAHK1::LexerFactoryAHK1, "ahk1", ahkWordListDesc);
@@ -12,6 +12,7 @@
 #include <assert.h>
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <algorithm>
@@ -29,6 +30,7 @@
 #include "OptionSet.h"
 #include "SubStyles.h"
 #include "DefaultLexer.h"
+#include "AHKKeyNames.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -119,20 +121,6 @@ namespace {
 		}
 	};
 
-	class CharBackup {
-		char* ptr;
-		char backup;
-	public:
-		CharBackup(char* ptr) : ptr{ptr} {
-			backup = *ptr;
-			*ptr = 0;
-		}
-
-		~CharBackup() {
-			*ptr = backup;
-		}
-	};
-
 	inline int toLower(int c)
 	{
 		if (c >= 'A' && c <= 'Z') {
@@ -298,135 +286,121 @@ namespace {
 		return valid;
 	}
 
-	inline char* skipHotkeyModifiers(char* str)
+	inline std::string_view trimLeft(std::string_view str)
+	{
+		for (; !str.empty() && isWhitespace(str.front()); str.remove_prefix(1));
+		return str;
+	}
+
+	inline std::string_view trimRight(std::string_view str)
+	{
+		for (; !str.empty() && isWhitespace(str.back()); str.remove_suffix(1));
+		return str;
+	}
+
+	inline std::string_view skipHotkeyModifiers(std::string_view str)
 	{
 		// See hotkey.cpp Hotkey::TextToModifiers() for more details.
-		for (; isHotkeyModifier(str[0]) && str[1] && str[1] != ' '; str++);
+		for (; str.length() >= 2 && isHotkeyModifier(str[0]) && str[1] != ' '; str.remove_prefix(1));
 		return str;
 	}
 
-	inline bool isValidKey(const char* str, WordList *namedKeys = nullptr)
+	inline bool isValidKey(std::string_view str, const WordList *namedKeys = nullptr)
 	{
 		// See keyboard_mouse.cpp TextToVK() for more details.
 
 		// Empty string is not a valid key
-		if (!*str) return false;
+		if (str.empty()) return false;
 
 		// Any single character is valid, and parsed by CharToVKAndModifiers()
-		if (!str[1]) return true;
+		if (str.length() == 1) return true;
 
 		// XX: If we aren't passed a namedKeys wordlist, we are validating a hotkey label.
 		// For simplicity, and because AutoHotkey parses this situation as a hotkey regardless
 		// of whether the named key is actually recognised or not (displaying an error message
 		// if it's not), allow any combination of identifier characters as a valid key specification.
 		if (!namedKeys) {
-			for (; *str; str++) {
-				if (!isIdChar(*str)) {
+			for (const char c : str) {
+				if (!isIdChar(c)) {
 					return false;
 				}
 			}
+			return true;
 		}
 
 		// Otherwise, we are checking the target of a potential remap hotkey. In this case,
 		// AutoHotkey only parses the situation as a remap if the named key is in fact
 		// recognised, otherwise falling back as a normal action.
-		else {
-			bool isVKorSC = false;
-
-			// vkNN - skip over hex digits
-			if (str[0] == 'v' && str[1] == 'k' && isHexNumeric(str[2])) {
-				isVKorSC = true;
-				for (str += 3; isHexNumeric(*str); str++);
-			}
-
-			// scNNN - skip over hex digits
-			if (str[0] == 's' && str[1] == 'c' && isHexNumeric(str[2])) {
-				isVKorSC = true;
-				for (str += 3; isHexNumeric(*str); str++);
-			}
-
-			// If either of above matched, ensure there are no trailing characters
-			if (isVKorSC) {
-				return !*str;
-			}
-
-			// Otherwise check the list of named keys
-			return namedKeys->InList(str);
+		// The built-in key names (including vkNN/scNNN) are checked first; the namedKeys
+		// wordlist only needs to hold any names AutoHotkey adds in the future.
+		if (IsAHKKeyName(str)) {
+			return true;
 		}
 
-		return true;
+		char name[64];
+		if (!*namedKeys || str.length() >= sizeof(name)) {
+			return false;
+		}
+		str.copy(name, str.length());
+		name[str.length()] = 0;
+		return namedKeys->InList(name);
 	}
 
-	inline bool isHotkeyCompatible(char* str, WordList &namedKeys, bool &isRemap)
+	inline bool isHotkeyCompatible(std::string_view str, const WordList &namedKeys, bool &isRemap)
 	{
 		// Assumptions:
-		// - strlen(str) >= 1
+		// - str.length() >= 1
 		// - No leading or trailing whitespace
 		// Refer to hotkey.cpp Hotkey::TextInterpret() for more details.
 		isRemap = false;
 
-		char* sep = strstr(str+1, "::"); // +1 so that we can detect ::: as colon-hotkey
-		if (!sep) return false;
+		const size_t sep = str.find("::", 1); // 1 so that we can detect ::: as colon-hotkey
+		if (sep == std::string_view::npos) return false;
 
 		// Isolate hotkey/remap target and remove leading whitespace
-		char* target = sep+2;
-		for (; isWhitespace(*target); target++);
+		std::string_view target = trimLeft(str.substr(sep+2));
 
 		// Isolate hotkey definition and remove trailing whitespace
-		for (; sep > str && isWhitespace(sep[-1]); sep--);
+		std::string_view hotkey = trimRight(str.substr(0, sep));
 
 		// Check and remove "up" modifier along with even more trailing whitespace
-		if (sep >= (str + 3) && isWhitespace(sep[-3]) && sep[-2] == 'u' && sep[-1] == 'p') {
-			for (sep -= 3; sep > str && isWhitespace(sep[-1]); sep--);
+		const size_t len = hotkey.length();
+		if (len >= 3 && isWhitespace(hotkey[len-3]) && hotkey[len-2] == 'u' && hotkey[len-1] == 'p') {
+			hotkey = trimRight(hotkey.substr(0, len-3));
 		}
 
-		// Temporarily introduce a NUL terminator
-		CharBackup chBackup1{sep};
-
 		// Check for single or composite hotkeys
 		bool valid = false;
-		sep = strstr(str, " & "); // AutoHotkey only allows spaces
-		if (sep) {
-			// Isolate second key
-			char* str2 = sep+3;
-			for (; isWhitespace(*str2); str2++);
-
-			// Remove trailing whitespace
-			for (; sep > str && isWhitespace(sep[-1]); sep--);
-
-			// Temporarily introduce a NUL terminator
-			CharBackup chBackup2{sep};
+		const size_t amp = hotkey.find(" & "); // AutoHotkey only allows spaces
+		if (amp != std::string_view::npos) {
+			// Isolate both keys, removing surrounding whitespace
+			std::string_view key1 = trimRight(hotkey.substr(0, amp));
+			const std::string_view key2 = trimLeft(hotkey.substr(amp+3));
 
 			// Skip the only allowed modifier (and leading whitespace)
-			if (*str == '~') {
-				for (str++; isWhitespace(*str); str++);
-				if (!*str) return false; // This is technically an error
+			if (!key1.empty() && key1.front() == '~') {
+				key1 = trimLeft(key1.substr(1));
+				if (key1.empty()) return false; // This is technically an error
 			}
 
 			// Validate the two keys
-			valid = isValidKey(str) && isValidKey(str2);
+			valid = isValidKey(key1) && isValidKey(key2);
 		} else {
-			// Skip modifiers
-			str = skipHotkeyModifiers(str);
-
-			// Validate the key
-			valid = isValidKey(str);
+			// Skip modifiers and validate the key
+			valid = isValidKey(skipHotkeyModifiers(hotkey));
 		}
 
 		// If above successfully validated the hotkey - check if this is a remap
-		if (valid && *target && *target != '{') {
+		if (valid && !target.empty() && target.front() != '{') {
 			// As per AHK source: "To use '{' as remap_dest, escape it!"
-			if (target[0] == '`' && target[1] == '{') {
-				target++;
+			if (target.length() >= 2 && target[0] == '`' && target[1] == '{') {
+				target.remove_prefix(1);
 			}
 
 			// Exempt 'Pause' (a valid built-in command) from being considered as a key name
-			if (strcmp(target, "pause") != 0) {
-				// Skip modifiers
-				target = skipHotkeyModifiers(target);
-
-				// Validate the key
-				isRemap = isValidKey(target, &namedKeys);
+			if (target != "pause") {
+				// Skip modifiers and validate the key
+				isRemap = isValidKey(skipHotkeyModifiers(target), &namedKeys);
 			}
 		}
 
@@ -458,6 +432,8 @@ namespace {
 				buf[outPos++] = c < 0x80 ? toLower(c) : 0x80;
 			}
 			buf[outPos] = 0;
+			// Length is now in characters rather than bytes
+			lineLen = outPos;
 		}
 
 		// Remove same-line comment if present
@@ -748,7 +724,7 @@ void SCI_METHOD LexerAHK2::Lex(Sci_PositionU startPos, Sci_Position lengthDoc, i
 				}
 
 				// Check if this line is a hotkey definition (including remaps).
-				else if (isHotkeyCompatible(buf, namedKeys, isRemap)) {
+				else if (isHotkeyCompatible(std::string_view(buf, lineLen), namedKeys, isRemap)) {
 					sc.SetState(SCE_AHK2_LABEL);
 					// We intentionally skip over the first character in order to
 					// correctly highlight ":::" (i.e. colon hotkey)
@@ -1154,7 +1130,7 @@ void SCI_METHOD LexerAHK2::Fold(Sci_PositionU startPos, Sci_Position lengthDoc,
 			bOnlySpaces = true;
 		}
 
-		if (!isWhitespace(ch)) {
+		if (!isWhitespaceOrCR(ch) && ch != '\n') {
 			bOnlySpaces = false;
 		}
 	}
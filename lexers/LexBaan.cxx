@@ -487,10 +487,7 @@ Sci_Position SCI_METHOD LexerBaan::WordListSet(int n, const char *wl) {
 	}
 	Sci_Position firstModification = -1;
 	if (WordListAbridgedN) {
-		WordListAbridged wlNew;
-		wlNew.Set(wl);
-		if (*WordListAbridgedN != wlNew) {
-			WordListAbridgedN->Set(wl);
+		if (WordListAbridgedN->Set(wl)) {
 			WordListAbridgedN->kwAbridged = strchr(wl, '~') != NULL;
 			WordListAbridgedN->kwHasSection = strchr(wl, ':') != NULL;
 
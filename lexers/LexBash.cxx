@@ -16,6 +16,7 @@
 #include <string_view>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <functional>
 
 #include "ILexer.h"
@@ -29,6 +30,7 @@
 #include "CharacterSet.h"
 #include "LexerModule.h"
 #include "OptionSet.h"
+#include "SparseState.h"
 #include "SubStyles.h"
 #include "DefaultLexer.h"
 
@@ -145,6 +147,45 @@ bool IsCommentLine(Sci_Position line, LexAccessor &styler) {
 	return false;
 }
 
+class HereDocCls {	// Class to manage HERE document elements
+public:
+	int State = 0;		// 0: '<<' encountered
+	// 1: collect the delimiter
+	// 2: here doc text (lines after the delimiter)
+	int Quote = 0;		// the char after '<<'
+	bool Quoted = false;	// true if Quote in ('\'','"','`')
+	bool Indent = false;	// indented delimiter (for <<-)
+	int DelimiterLength = 0;	// Delimiter.length()
+	std::string Delimiter;	// the Delimiter
+	void Append(int ch) {
+		Delimiter.push_back(static_cast<char>(ch));
+		DelimiterLength++;
+	}
+	bool operator==(const HereDocCls &other) const noexcept {
+		return State == other.State && Quote == other.Quote && Quoted == other.Quoted &&
+			Indent == other.Indent && Delimiter == other.Delimiter;
+	}
+};
+
+// State at the end of a line inside a here-doc body: the here-doc whose body continues
+// on the next line followed by any others started on the same line as it, and the
+// command state to resume with after the last body. Empty outside here-doc bodies.
+struct HereDocLineState {
+	std::vector<HereDocCls> hereDocs;
+	int cmdState = BASH_CMD_START;
+	int testExprType = 0;
+	bool Empty() const noexcept {
+		return hereDocs.empty();
+	}
+	bool operator==(const HereDocLineState &other) const noexcept {
+		return hereDocs == other.hereDocs && cmdState == other.cmdState &&
+			testExprType == other.testExprType;
+	}
+	bool operator!=(const HereDocLineState &other) const noexcept {
+		return !(*this == other);
+	}
+};
+
 struct OptionsBash {
 	bool fold;
 	bool foldComment;
@@ -202,6 +243,8 @@ class LexerBash : public DefaultLexer {
 	OptionSetBash osBash;
 	enum { ssIdentifier, ssScalar };
 	SubStyles subStyles;
+	// Here-docs open at the end of each line so lexing can resume inside a body
+	SparseState<HereDocLineState> hereDocs;
 public:
 	LexerBash() :
 		DefaultLexer("bash", SCLEX_BASH, lexicalClasses, ELEMENTS(lexicalClasses)),
@@ -289,10 +332,7 @@ Sci_Position SCI_METHOD LexerBash::WordListSet(int n, const char *wl) {
 	}
 	Sci_Position firstModification = -1;
 	if (wordListN) {
-		WordList wlNew;
-		wlNew.Set(wl);
-		if (*wordListN != wlNew) {
-			wordListN->Set(wl);
+		if (wordListN->Set(wl)) {
 			firstModification = 0;
 		}
 	}
@@ -317,32 +357,8 @@ void SCI_METHOD LexerBash::Lex(Sci_PositionU startPos, Sci_Position length, int
 	CharacterSet setHereDoc2(CharacterSet::setAlphaNum, "_-+!%*,./:=?@[]^`{}~");
 	CharacterSet setLeftShift(CharacterSet::setDigits, "$");
 
-	class HereDocCls {	// Class to manage HERE document elements
-	public:
-		int State;		// 0: '<<' encountered
-		// 1: collect the delimiter
-		// 2: here doc text (lines after the delimiter)
-		int Quote;		// the char after '<<'
-		bool Quoted;		// true if Quote in ('\'','"','`')
-		bool Indent;		// indented delimiter (for <<-)
-		int DelimiterLength;	// strlen(Delimiter)
-		char Delimiter[HERE_DELIM_MAX];	// the Delimiter
-		HereDocCls() {
-			State = 0;
-			Quote = 0;
-			Quoted = false;
-			Indent = 0;
-			DelimiterLength = 0;
-			Delimiter[0] = '\0';
-		}
-		void Append(int ch) {
-			Delimiter[DelimiterLength++] = static_cast<char>(ch);
-			Delimiter[DelimiterLength] = '\0';
-		}
-		~HereDocCls() {
-		}
-	};
 	HereDocCls HereDoc;
+	std::vector<HereDocCls> hereDocsPending;	// further here-docs started on the same line, in order
 
 	class QuoteCls {	// Class to manage quote pairs (simplified vs LexPerl)
 		public:
@@ -423,26 +439,53 @@ void SCI_METHOD LexerBash::Lex(Sci_PositionU startPos, Sci_Position length, int
 	int testExprType = 0;
 	LexAccessor styler(pAccess);
 
-	// Always backtracks to the start of a line that is not a continuation
-	// of the previous line (i.e. start of a bash command segment)
 	Sci_Position ln = styler.GetLine(startPos);
-	if (ln > 0 && startPos == static_cast<Sci_PositionU>(styler.LineStart(ln)))
-		ln--;
-	for (;;) {
-		startPos = styler.LineStart(ln);
-		if (ln == 0 || styler.GetLineState(ln) == BASH_CMD_START)
-			break;
-		ln--;
+	const HereDocLineState hereDocState = (ln > 0) ? hereDocs.ValueAt(ln - 1) : HereDocLineState();
+	if (initStyle == SCE_SH_HERE_Q && !hereDocState.Empty() &&
+		startPos == static_cast<Sci_PositionU>(styler.LineStart(ln))) {
+		// Inside a here-doc body, resume from the state recorded at the end of
+		// the previous line instead of backtracking to the delimiter
+		HereDoc = hereDocState.hereDocs.front();
+		hereDocsPending.assign(hereDocState.hereDocs.begin() + 1, hereDocState.hereDocs.end());
+		cmdState = hereDocState.cmdState;
+		testExprType = hereDocState.testExprType;
+	} else {
+		// Always backtracks to the start of a line that is not a continuation
+		// of the previous line (i.e. start of a bash command segment)
+		if (ln > 0 && startPos == static_cast<Sci_PositionU>(styler.LineStart(ln)))
+			ln--;
+		for (;;) {
+			startPos = styler.LineStart(ln);
+			if (ln == 0 || styler.GetLineState(ln) == BASH_CMD_START)
+				break;
+			ln--;
+		}
+		initStyle = SCE_SH_DEFAULT;
 	}
-	initStyle = SCE_SH_DEFAULT;
+	SparseState<HereDocLineState> hereDocsNew(ln);
+	bool hereDocsChanged = true;	// so recorded for the first line then after each change
 
 	StyleContext sc(startPos, endPos - startPos, initStyle, styler);
+	auto lineState = [&]() {
+		HereDocLineState state;
+		if (sc.state == SCE_SH_HERE_Q) {
+			state.hereDocs.push_back(HereDoc);
+			state.hereDocs.insert(state.hereDocs.end(), hereDocsPending.begin(), hereDocsPending.end());
+			state.cmdState = cmdState;
+			state.testExprType = testExprType;
+		}
+		return state;
+	};
 
 	for (; sc.More(); sc.Forward()) {
 
 		// handle line continuation, updates per-line stored state
 		if (sc.atLineStart) {
 			ln = styler.GetLine(sc.currentPos);
+			if (hereDocsChanged && ln > 0) {
+				hereDocsNew.Set(ln - 1, lineState());
+				hereDocsChanged = false;
+			}
 			if (sc.state == SCE_SH_STRING
 			 || sc.state == SCE_SH_BACKTICKS
 			 || sc.state == SCE_SH_CHARACTER
@@ -624,7 +667,7 @@ void SCI_METHOD LexerBash::Lex(Sci_PositionU startPos, Sci_Position length, int
 					HereDoc.Quote = sc.chNext;
 					HereDoc.Quoted = false;
 					HereDoc.DelimiterLength = 0;
-					HereDoc.Delimiter[HereDoc.DelimiterLength] = '\0';
+					HereDoc.Delimiter.clear();
 					if (sc.chNext == '\'' || sc.chNext == '\"') {	// a quoted here-doc delimiter (' or ")
 						sc.Forward();
 						HereDoc.Quoted = true;
@@ -691,16 +734,21 @@ void SCI_METHOD LexerBash::Lex(Sci_PositionU startPos, Sci_Position length, int
 					sc.GetCurrent(s, sizeof(s));
 					if (sc.LengthCurrent() == 0) {  // '' or "" delimiters
 						if ((prefixws == 0 || HereDoc.Indent) &&
-							HereDoc.Quoted && HereDoc.DelimiterLength == 0)
+							HereDoc.Quoted && HereDoc.DelimiterLength == 0) {
 							sc.SetState(SCE_SH_DEFAULT);
+							HereDoc.State = 0;
+							hereDocsChanged = true;
+						}
 						break;
 					}
 					if (s[strlen(s) - 1] == '\r')
 						s[strlen(s) - 1] = '\0';
-					if (strcmp(HereDoc.Delimiter, s) == 0) {
+					if (HereDoc.Delimiter == s) {
 						if ((prefixws == 0) ||	// indentation rule
 							(prefixws > 0 && HereDoc.Indent)) {
 							sc.SetState(SCE_SH_DEFAULT);
+							HereDoc.State = 0;
+							hereDocsChanged = true;
 							break;
 						}
 					}
@@ -794,26 +842,32 @@ void SCI_METHOD LexerBash::Lex(Sci_PositionU startPos, Sci_Position length, int
 		}
 
 		// Must check end of HereDoc state 1 before default state is handled
-		if (HereDoc.State == 1 && sc.MatchLineEnd()) {
+		if ((HereDoc.State == 1 || (HereDoc.State == 0 && !hereDocsPending.empty())) && sc.MatchLineEnd()) {
 			// Begin of here-doc (the line after the here-doc delimiter):
 			// Lexically, the here-doc starts from the next line after the >>, but the
 			// first line of here-doc seem to follow the style of the last EOL sequence
-			HereDoc.State = 2;
-			if (HereDoc.Quoted) {
-				if (sc.state == SCE_SH_HERE_DELIM) {
+			if (HereDoc.State == 1) {
+				HereDoc.State = 2;
+				if (HereDoc.Quoted && sc.state == SCE_SH_HERE_DELIM) {
 					// Missing quote at end of string! Syntax error in bash 4.3
 					// Mark this bit as an error, do not colour any here-doc
 					sc.ChangeState(SCE_SH_ERROR);
 					sc.SetState(SCE_SH_DEFAULT);
+				} else if (!HereDoc.Quoted && HereDoc.DelimiterLength == 0) {
+					// no delimiter, illegal (but '' and "" are legal)
+					sc.ChangeState(SCE_SH_ERROR);
+					sc.SetState(SCE_SH_DEFAULT);
 				} else {
-					// HereDoc.Quote always == '\''
-					sc.SetState(SCE_SH_HERE_Q);
+					hereDocsPending.push_back(HereDoc);
 				}
-			} else if (HereDoc.DelimiterLength == 0) {
-				// no delimiter, illegal (but '' and "" are legal)
-				sc.ChangeState(SCE_SH_ERROR);
-				sc.SetState(SCE_SH_DEFAULT);
-			} else {
+			}
+			if (!hereDocsPending.empty()) {
+				// Stacked here-docs have their bodies one after another, in order,
+				// so the next body starts after the line ending the previous one
+				HereDoc = hereDocsPending.front();
+				hereDocsPending.erase(hereDocsPending.begin());
+				HereDoc.State = 2;
+				hereDocsChanged = true;
 				sc.SetState(SCE_SH_HERE_Q);
 			}
 		}
@@ -906,6 +960,9 @@ void SCI_METHOD LexerBash::Lex(Sci_PositionU startPos, Sci_Position length, int
 				}
 			} else if (sc.Match('<', '<')) {
 				sc.SetState(SCE_SH_HERE_DELIM);
+				if (HereDoc.State == 1) {	// stacked after another here-doc on this line
+					hereDocsPending.push_back(HereDoc);
+				}
 				HereDoc.State = 0;
 				if (sc.GetRelative(2) == '-') {	// <<- indent case
 					HereDoc.Indent = true;
@@ -991,7 +1048,11 @@ void SCI_METHOD LexerBash::Lex(Sci_PositionU startPos, Sci_Position length, int
 		}// sc.state
 	}
 	sc.Complete();
-	if (sc.state == SCE_SH_HERE_Q) {
+	if (hereDocsChanged && sc.atLineStart && sc.currentLine > 0) {
+		hereDocsNew.Set(sc.currentLine - 1, lineState());
+	}
+	const bool hereDocsMerged = hereDocs.Merge(hereDocsNew, sc.currentLine);
+	if (hereDocsMerged || sc.state == SCE_SH_HERE_Q) {
 		styler.ChangeLexerState(sc.currentPos, styler.Length());
 	}
 	sc.Complete();
@@ -7,6 +7,7 @@
 // The License.txt file describes the conditions under which this software may be distributed.
 
 #include <cstdlib>
+#include <cstdint>
 #include <cassert>
 #include <cstring>
 
@@ -15,9 +16,11 @@
 #include <string_view>
 #include <vector>
 #include <map>
+#include <optional>
 #include <algorithm>
 #include <iterator>
 #include <functional>
+#include <memory>
 
 #include "ILexer.h"
 #include "Scintilla.h"
@@ -32,7 +35,10 @@
 #include "LexerModule.h"
 #include "OptionSet.h"
 #include "SparseState.h"
+#include "LineCheckpoints.h"
 #include "SubStyles.h"
+#include "MacroDatabase.h"
+#include "LexerClone.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -99,43 +105,6 @@ bool OnlySpaceOrTab(const std::string &s) noexcept {
 	return true;
 }
 
-using Tokens = std::vector<std::string>;
-
-Tokens StringSplit(const std::string &text, int separator) {
-	Tokens vs(text.empty() ? 0 : 1);
-	for (const char ch : text) {
-		if (ch == separator) {
-			vs.emplace_back();
-		} else {
-			vs.back() += ch;
-		}
-	}
-	return vs;
-}
-
-struct BracketPair {
-	Tokens::iterator itBracket;
-	Tokens::iterator itEndBracket;
-};
-
-BracketPair FindBracketPair(Tokens &tokens) {
-	const Tokens::iterator itBracket = std::find(tokens.begin(), tokens.end(), "(");
-	if (itBracket != tokens.end()) {
-		size_t nest = 0;
-		for (Tokens::iterator itTok = itBracket; itTok != tokens.end(); ++itTok) {
-			if (*itTok == "(") {
-				nest++;
-			} else if (*itTok == ")") {
-				nest--;
-				if (nest == 0) {
-					return { itBracket, itTok };
-				}
-			}
-		}
-	}
-	return { tokens.end(), tokens.end() };
-}
-
 void highlightTaskMarker(StyleContext &sc, LexAccessor &styler,
 		int activity, const WordList &markerList, bool caseSensitive){
 	if ((isoperator(sc.chPrev) || IsASpace(sc.chPrev)) && markerList.Length()) {
@@ -194,6 +163,50 @@ public:
 	}
 };
 
+// Text that ends a raw string: ')' delimiter '"' for C++ or '`' for JavaScript.
+// C++ limits delimiters to 16 characters so the text is held inline and copying it into
+// the per-line state does not allocate. Longer delimiters are invalid and never match.
+class RawStringTerminator {
+	static constexpr size_t maxDelimiter = 16;
+	char text[maxDelimiter + 2] {};
+	unsigned char length = 0;
+	bool overflow = false;
+public:
+	bool Empty() const noexcept {
+		return (length == 0) && !overflow;
+	}
+	size_t Length() const noexcept {
+		return length;
+	}
+	bool Overflowed() const noexcept {
+		return overflow;
+	}
+	void Clear() noexcept {
+		length = 0;
+		overflow = false;
+	}
+	void Append(char ch) noexcept {
+		if (length < std::size(text)) {
+			text[length++] = ch;
+		} else {
+			overflow = true;
+		}
+	}
+	bool Matches(LexAccessor &styler, Sci_Position position) const {
+		if (overflow || (length == 0))
+			return false;
+		const char *current = styler.BufferPointer(position, length);
+		return current && (current[0] == text[0]) && (memcmp(current, text, length) == 0);
+	}
+	bool operator==(const RawStringTerminator &other) const noexcept {
+		return (length == other.length) && (overflow == other.overflow) &&
+			(memcmp(text, other.text, length) == 0);
+	}
+	bool operator!=(const RawStringTerminator &other) const noexcept {
+		return !(*this == other);
+	}
+};
+
 std::string GetRestOfLine(LexAccessor &styler, Sci_Position start, bool allowSpace) {
 	std::string restOfLine;
 	Sci_Position line = styler.GetLine(start);
@@ -228,17 +241,6 @@ constexpr bool IsStreamCommentStyle(int style) noexcept {
 		style == SCE_C_COMMENTDOCKEYWORDERROR;
 }
 
-struct PPDefinition {
-	Sci_Position line;
-	std::string key;
-	std::string value;
-	bool isUndef;
-	std::string arguments;
-	PPDefinition(Sci_Position line_, const std::string &key_, const std::string &value_, bool isUndef_ = false, const std::string &arguments_="") :
-		line(line_), key(key_), value(value_), isUndef(isUndef_), arguments(arguments_) {
-	}
-};
-
 constexpr int inactiveFlag = 0x40;
 
 class LinePPState {
@@ -304,25 +306,887 @@ public:
 			ifTaken |= maskLevel();
 		}
 	}
+	bool operator==(const LinePPState &other) const noexcept {
+		return state == other.state && ifTaken == other.ifTaken && level == other.level;
+	}
+	bool operator!=(const LinePPState &other) const noexcept {
+		return !(*this == other);
+	}
 };
 
 // Hold the preprocessor state for each line seen.
-// Currently one entry per line but could become sparse with just one entry per preprocessor line.
+// Only the lines where the state changes are stored so the size depends on the number of
+// preprocessor lines. Lookup is a binary search and adding a line discards any later lines.
 class PPStates {
-	std::vector<LinePPState> vlls;
+	SparseState<LinePPState> vlls;
+	// Lines from here on have not been seen
+	Sci_Position linesSeen = 0;
 public:
-	LinePPState ForLine(Sci_Position line) const noexcept {
-		if ((line > 0) && (vlls.size() > static_cast<size_t>(line))) {
-			return vlls[line];
+	LinePPState ForLine(Sci_Position line) {
+		if ((line > 0) && (line < linesSeen)) {
+			return vlls.ValueAt(line);
 		}
 		return {};
 	}
 	void Add(Sci_Position line, LinePPState lls) {
-		vlls.resize(line+1);
-		vlls[line] = lls;
+		vlls.Set(line, lls);
+		linesSeen = line + 1;
+	}
+};
+
+enum class PreprocessorFold { none, start, middle, end };
+
+// Classify the preprocessor directive after the '#' at position for folding.
+PreprocessorFold PreprocessorFoldAt(LexAccessor &styler, Sci_PositionU position, Sci_PositionU endPos) {
+	Sci_PositionU j = position + 1;
+	while ((j < endPos) && IsASpaceOrTab(styler.SafeGetCharAt(j))) {
+		j++;
+	}
+	if (styler.Match(j, "region") || styler.Match(j, "if")) {
+		return PreprocessorFold::start;
+	} else if (styler.Match(j, "end")) {
+		return PreprocessorFold::end;
+	} else if (styler.Match(j, "else") || styler.Match(j, "elif")) {
+		return PreprocessorFold::middle;
+	}
+	return PreprocessorFold::none;
+}
+
+// Fold level changes found by Lex for each line of the range it styled, so that Fold
+// on the same range does not have to examine every character and style again.
+// Levels are relative to the level at the start of each line.
+// Hints are only used for the document and length they were found in, so a Fold
+// of another document or after a change to this one folds from the styles.
+class FoldHints {
+	struct LineHint {
+		int next = 0;
+		// Lowest level on the line before an opening brace, for folding "} else {"
+		int minimum = 0;
+	};
+	bool valid = false;
+	const Scintilla::IDocument *document = nullptr;
+	Sci_Position lengthDocument = 0;
+	Sci_PositionU startPos = 0;
+	Sci_PositionU endPos = 0;
+	Sci_Position lineStart = 0;
+	std::vector<LineHint> lines;
+	LineHint &At(Sci_Position line) {
+		const size_t index = line - lineStart;
+		if (index >= lines.size()) {
+			lines.resize(index + 1);
+		}
+		return lines[index];
+	}
+public:
+	void Start(const Scintilla::IDocument *document_, Sci_Position lengthDocument_,
+		Sci_PositionU startPos_, Sci_PositionU endPos_, Sci_Position lineStart_) {
+		valid = true;
+		document = document_;
+		lengthDocument = lengthDocument_;
+		startPos = startPos_;
+		endPos = endPos_;
+		lineStart = lineStart_;
+		lines.clear();
+	}
+	void Clear() noexcept {
+		valid = false;
+		document = nullptr;
+		lines.clear();
+	}
+	bool Covers(const Scintilla::IDocument *document_, Sci_Position lengthDocument_,
+		Sci_PositionU startPos_, Sci_PositionU endPos_) const noexcept {
+		return valid && (document_ == document) && (lengthDocument_ == lengthDocument) &&
+			(startPos_ == startPos) && (endPos_ == endPos);
+	}
+	void Open(Sci_Position line, bool measureMinimum) {
+		LineHint &hint = At(line);
+		if (measureMinimum && (hint.minimum > hint.next)) {
+			hint.minimum = hint.next;
+		}
+		hint.next++;
+	}
+	void Close(Sci_Position line) {
+		At(line).next--;
+	}
+	void Middle(Sci_Position line) {
+		At(line).minimum--;
+	}
+	int Next(Sci_Position line) const noexcept {
+		const size_t index = line - lineStart;
+		return (index < lines.size()) ? lines[index].next : 0;
+	}
+	int Minimum(Sci_Position line) const noexcept {
+		const size_t index = line - lineStart;
+		return (index < lines.size()) ? lines[index].minimum : 0;
+	}
+	// Restore the hint for a line when lexing resumes part way through it
+	void Resume(Sci_Position line, int next, int minimum) {
+		LineHint &hint = At(line);
+		hint.next = next;
+		hint.minimum = minimum;
+	}
+};
+
+// Variables of Lex that carry state between tokens so lexing can resume at a
+// checkpoint inside a long line.
+struct CheckpointCPP {
+	int state;
+	int chPrev;
+	int chPrevNonWhite;
+	int visibleChars;
+	int styleBeforeDCKeyword;
+	int styleBeforeTaskMarker;
+	int activitySet;
+	bool lastWordWasUUID;
+	bool continuationLine;
+	bool isIncludePreprocessor;
+	bool isStringInPreprocessor;
+	bool inRERange;
+	bool seenDocKeyBrace;
+	RawStringTerminator rawStringTerminator;
+	int foldNext;
+	int foldMinimum;
+	bool operator==(const CheckpointCPP &other) const noexcept {
+		return state == other.state &&
+			chPrev == other.chPrev &&
+			chPrevNonWhite == other.chPrevNonWhite &&
+			visibleChars == other.visibleChars &&
+			styleBeforeDCKeyword == other.styleBeforeDCKeyword &&
+			styleBeforeTaskMarker == other.styleBeforeTaskMarker &&
+			activitySet == other.activitySet &&
+			lastWordWasUUID == other.lastWordWasUUID &&
+			continuationLine == other.continuationLine &&
+			isIncludePreprocessor == other.isIncludePreprocessor &&
+			isStringInPreprocessor == other.isStringInPreprocessor &&
+			inRERange == other.inRERange &&
+			seenDocKeyBrace == other.seenDocKeyBrace &&
+			rawStringTerminator == other.rawStringTerminator &&
+			foldNext == other.foldNext &&
+			foldMinimum == other.foldMinimum;
+	}
+};
+
+struct SymbolValue {
+	std::string value;
+	std::string arguments;
+	SymbolValue() noexcept = default;
+	SymbolValue(const std::string &value_, const std::string &arguments_) : value(value_), arguments(arguments_) {
+	}
+	bool IsMacro() const noexcept {
+		return !arguments.empty();
+	}
+};
+
+// Definition found in a SymbolTable, referring into the table or its database
+struct Symbol {
+	std::string_view value;
+	std::string_view arguments;
+	bool IsMacro() const noexcept {
+		return !arguments.empty();
+	}
+};
+
+// Definitions in force before the document starts: the preprocessor definitions word
+// list over an optional database. Immutable once built so a lexer and its clones share it.
+class InitialDefinitions {
+	std::shared_ptr<const MacroDatabase> database;
+	std::map<std::string, SymbolValue, std::less<>> definitions;
+	uint64_t fingerprint = 0;
+public:
+	InitialDefinitions(std::shared_ptr<const MacroDatabase> database_, const WordList &ppDefinitions) :
+		database(std::move(database_)) {
+		fingerprint = database ? database->Fingerprint() : 0;
+		for (int nDefinition = 0; nDefinition < ppDefinitions.Length(); nDefinition++) {
+			const char *cpDefinition = ppDefinitions.WordAt(nDefinition);
+			const char *cpEquals = strchr(cpDefinition, '=');
+			std::string name;
+			SymbolValue symbol("1", "");
+			if (cpEquals) {
+				name.assign(cpDefinition, cpEquals - cpDefinition);
+				symbol.value = cpEquals + 1;
+				const size_t bracket = name.find('(');
+				const size_t bracketEnd = name.find(')');
+				if ((bracket != std::string::npos) && (bracketEnd != std::string::npos)) {
+					// Macro
+					symbol.arguments = name.substr(bracket + 1, bracketEnd - bracket - 1);
+					name = name.substr(0, bracket);
+				}
+			} else {
+				name = cpDefinition;
+			}
+			// Later definitions of a name replace earlier ones
+			if (const std::optional<Symbol> previous = Find(name))
+				fingerprint ^= MacroDatabase::HashDefinition(name, previous->arguments, previous->value);
+			fingerprint ^= MacroDatabase::HashDefinition(name, symbol.arguments, symbol.value);
+			definitions.insert_or_assign(name, symbol);
+		}
+	}
+	std::optional<Symbol> Find(std::string_view key) const {
+		const auto it = definitions.find(key);
+		if (it != definitions.end())
+			return Symbol { it->second.value, it->second.arguments };
+		MacroDatabase::Definition definition;
+		if (database && database->Find(key, definition))
+			return Symbol { definition.value, definition.arguments };
+		return {};
+	}
+	uint64_t Fingerprint() const noexcept {
+		return fingerprint;
+	}
+};
+
+// Preprocessor definitions as a history of changes by line over the shared
+// initial definitions.
+// Each symbol has its versions in line order so the table as it stands after the
+// most recent change is available without copying, and restarting at a line only
+// discards the later changes rather than rebuilding the table.
+// A fingerprint of the contents is kept after each change: equal tables have equal
+// fingerprints so results derived from the definitions can be cached.
+class SymbolTable {
+	struct Version {
+		Sci_Position line;
+		bool defined;
+		SymbolValue symbol;
+	};
+	using Histories = std::map<std::string, std::vector<Version>, std::less<>>;
+	struct Change {
+		Sci_Position line;
+		Histories::iterator history;
+		uint64_t fingerprint;
+	};
+	std::shared_ptr<const InitialDefinitions> initial;
+	Histories histories;
+	std::vector<Change> changes;
+	void Record(Sci_Position line, const std::string &key, bool defined, const SymbolValue &symbol) {
+		uint64_t fingerprint = Fingerprint();
+		if (const std::optional<Symbol> previous = Find(key))
+			fingerprint ^= MacroDatabase::HashDefinition(key, previous->arguments, previous->value);
+		if (defined)
+			fingerprint ^= MacroDatabase::HashDefinition(key, symbol.arguments, symbol.value);
+		const auto it = histories.try_emplace(key).first;
+		it->second.push_back({ line, defined, symbol });
+		changes.push_back({ line, it, fingerprint });
+	}
+public:
+	// Replacing the initial definitions discards all changes
+	void SetInitial(std::shared_ptr<const InitialDefinitions> initial_) noexcept {
+		histories.clear();
+		changes.clear();
+		initial = std::move(initial_);
+	}
+	void Define(Sci_Position line, const std::string &key, const SymbolValue &symbol) {
+		Record(line, key, true, symbol);
+	}
+	void Undefine(Sci_Position line, const std::string &key) {
+		if (Find(key))
+			Record(line, key, false, SymbolValue());
+	}
+	// Discard changes made on or after line. Returns true if any were discarded.
+	bool Truncate(Sci_Position line) {
+		const auto itFirst = std::lower_bound(changes.begin(), changes.end(), line,
+			[](const Change &change, Sci_Position l) noexcept { return change.line < l; });
+		if (itFirst == changes.end())
+			return false;
+		for (auto it = changes.rbegin(); it.base() != itFirst; ++it) {
+			std::vector<Version> &versions = it->history->second;
+			versions.pop_back();
+			if (versions.empty())
+				histories.erase(it->history);
+		}
+		changes.erase(itFirst, changes.end());
+		return true;
+	}
+	std::optional<Symbol> Find(std::string_view key) const {
+		const auto it = histories.find(key);
+		if (it != histories.end()) {
+			const Version &version = it->second.back();
+			if (!version.defined)
+				return {};
+			return Symbol { version.symbol.value, version.symbol.arguments };
+		}
+		if (initial)
+			return initial->Find(key);
+		return {};
+	}
+	uint64_t Fingerprint() const noexcept {
+		if (!changes.empty())
+			return changes.back().fingerprint;
+		return initial ? initial->Fingerprint() : 0;
 	}
 };
 
+// Preprocessor conditional expressions.
+// A conditional is split into tokens, macros are expanded, and the result is parsed
+// with C precedence into a sequence of instructions for a stack machine which
+// is then run with 64-bit signed arithmetic.
+
+enum class Punctuator : unsigned char {
+	none, leftParen, rightParen, question, colon, comma,
+	exclamation, tilde, star, slash, percent, plus, minus, shiftLeft, shiftRight,
+	less, lessEqual, greater, greaterEqual, equal, notEqual,
+	ampersand, caret, bar, logicalAnd, logicalOr, other
+};
+
+struct PPToken {
+	enum class Kind : unsigned char { number, identifier, punctuator };
+	Kind kind = Kind::number;
+	Punctuator punctuator = Punctuator::none;
+	int64_t value = 0;
+	std::string_view text;
+	bool Is(Punctuator p) const noexcept {
+		return kind == Kind::punctuator && punctuator == p;
+	}
+	static PPToken Number(int64_t value_) noexcept {
+		PPToken token;
+		token.value = value_;
+		return token;
+	}
+};
+
+using PPTokens = std::vector<PPToken>;
+
+constexpr int DigitValue(int ch) noexcept {
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+	return 99;
+}
+
+// Decimal, octal, hexadecimal, and binary literals with digit separators.
+// Suffixes are ignored and values wrap to 64 bits.
+int64_t IntegerValue(std::string_view text) noexcept {
+	unsigned int base = 10;
+	size_t i = 0;
+	if ((text.length() > 1) && (text[0] == '0')) {
+		if (text[1] == 'x' || text[1] == 'X') {
+			base = 16;
+			i = 2;
+		} else if (text[1] == 'b' || text[1] == 'B') {
+			base = 2;
+			i = 2;
+		} else {
+			base = 8;
+			i = 1;
+		}
+	}
+	uint64_t value = 0;
+	for (; i < text.length(); i++) {
+		if (text[i] == '\'')
+			continue;
+		const unsigned int digit = DigitValue(static_cast<unsigned char>(text[i]));
+		if (digit >= base)
+			break;
+		value = value * base + digit;
+	}
+	return static_cast<int64_t>(value);
+}
+
+// Value of a character literal body, after the opening quote.
+int64_t CharacterValue(std::string_view text) noexcept {
+	if (text.empty())
+		return 0;
+	if (text[0] != '\\' || text.length() < 2)
+		return static_cast<unsigned char>(text[0]);
+	switch (text[1]) {
+	case 'a': return '\a';
+	case 'b': return '\b';
+	case 'f': return '\f';
+	case 'n': return '\n';
+	case 'r': return '\r';
+	case 't': return '\t';
+	case 'v': return '\v';
+	case 'x': return IntegerValue(std::string("0x").append(text.substr(2)));
+	default:
+		if (text[1] >= '0' && text[1] <= '7')
+			return IntegerValue(std::string("0").append(text.substr(1)));
+		return static_cast<unsigned char>(text[1]);
+	}
+}
+
+void TokenizeExpression(std::string_view text, const CharacterSet &setWordStart, PPTokens &tokens) {
+	size_t i = 0;
+	while (i < text.length()) {
+		const unsigned char ch = text[i];
+		const unsigned char chNext = (i + 1 < text.length()) ? text[i + 1] : 0;
+		const size_t start = i;
+		PPToken token;
+		if (IsSpaceOrTab(ch)) {
+			i++;
+			continue;
+		} else if (IsADigit(ch)) {
+			// Preprocessing number
+			while ((i < text.length()) && (IsAlphaNumeric(text[i]) || text[i] == '.' || text[i] == '_' || text[i] == '\'')) {
+				i++;
+			}
+			token.value = IntegerValue(text.substr(start, i - start));
+		} else if (setWordStart.Contains(ch)) {
+			while ((i < text.length()) && (setWordStart.Contains(text[i]) || IsADigit(text[i]))) {
+				i++;
+			}
+			token.kind = PPToken::Kind::identifier;
+		} else if (ch == '\'') {
+			i++;
+			while ((i < text.length()) && (text[i] != '\'')) {
+				i += (text[i] == '\\') ? 2 : 1;
+			}
+			i = std::min(i + 1, text.length());
+			token.value = CharacterValue(text.substr(start + 1, i - start - 1));
+		} else {
+			token.kind = PPToken::Kind::punctuator;
+			token.punctuator = Punctuator::other;
+			i++;
+			switch (ch) {
+			case '(': token.punctuator = Punctuator::leftParen; break;
+			case ')': token.punctuator = Punctuator::rightParen; break;
+			case '?': token.punctuator = Punctuator::question; break;
+			case ':': token.punctuator = Punctuator::colon; break;
+			case ',': token.punctuator = Punctuator::comma; break;
+			case '~': token.punctuator = Punctuator::tilde; break;
+			case '*': token.punctuator = Punctuator::star; break;
+			case '/': token.punctuator = Punctuator::slash; break;
+			case '%': token.punctuator = Punctuator::percent; break;
+			case '+': token.punctuator = Punctuator::plus; break;
+			case '-': token.punctuator = Punctuator::minus; break;
+			case '^': token.punctuator = Punctuator::caret; break;
+			case '!':
+				token.punctuator = Punctuator::exclamation;
+				if (chNext == '=') {
+					token.punctuator = Punctuator::notEqual;
+					i++;
+				}
+				break;
+			case '=':
+				if (chNext == '=') {
+					token.punctuator = Punctuator::equal;
+					i++;
+				}
+				break;
+			case '<':
+			case '>':
+				if (chNext == ch) {
+					token.punctuator = (ch == '<') ? Punctuator::shiftLeft : Punctuator::shiftRight;
+					i++;
+				} else if (chNext == '=') {
+					token.punctuator = (ch == '<') ? Punctuator::lessEqual : Punctuator::greaterEqual;
+					i++;
+				} else {
+					token.punctuator = (ch == '<') ? Punctuator::less : Punctuator::greater;
+				}
+				break;
+			case '&':
+			case '|':
+				if (chNext == ch) {
+					token.punctuator = (ch == '&') ? Punctuator::logicalAnd : Punctuator::logicalOr;
+					i++;
+				} else {
+					token.punctuator = (ch == '&') ? Punctuator::ampersand : Punctuator::bar;
+				}
+				break;
+			default:
+				// Strings and other punctuation make the expression invalid
+				break;
+			}
+		}
+		token.text = text.substr(start, i - start);
+		tokens.push_back(token);
+	}
+}
+
+enum class Opcode : unsigned char {
+	push, negate, logicalNot, complement,
+	multiply, divide, modulo, add, subtract, shiftLeft, shiftRight,
+	less, lessEqual, greater, greaterEqual, equal, notEqual,
+	bitAnd, bitXor, bitOr, logicalAnd, logicalOr, conditional, comma
+};
+
+struct Instruction {
+	Opcode opcode;
+	int64_t value;
+};
+
+// Binary operators from loosest to tightest binding.
+constexpr int precedenceLowest = 0;
+constexpr int precedenceHighest = 9;
+
+int BinaryPrecedence(Punctuator p) noexcept {
+	switch (p) {
+	case Punctuator::logicalOr: return 0;
+	case Punctuator::logicalAnd: return 1;
+	case Punctuator::bar: return 2;
+	case Punctuator::caret: return 3;
+	case Punctuator::ampersand: return 4;
+	case Punctuator::equal: case Punctuator::notEqual: return 5;
+	case Punctuator::less: case Punctuator::lessEqual:
+	case Punctuator::greater: case Punctuator::greaterEqual: return 6;
+	case Punctuator::shiftLeft: case Punctuator::shiftRight: return 7;
+	case Punctuator::plus: case Punctuator::minus: return 8;
+	case Punctuator::star: case Punctuator::slash: case Punctuator::percent: return 9;
+	default: return -1;
+	}
+}
+
+Opcode BinaryOpcode(Punctuator p) noexcept {
+	switch (p) {
+	case Punctuator::logicalOr: return Opcode::logicalOr;
+	case Punctuator::logicalAnd: return Opcode::logicalAnd;
+	case Punctuator::bar: return Opcode::bitOr;
+	case Punctuator::caret: return Opcode::bitXor;
+	case Punctuator::ampersand: return Opcode::bitAnd;
+	case Punctuator::equal: return Opcode::equal;
+	case Punctuator::notEqual: return Opcode::notEqual;
+	case Punctuator::less: return Opcode::less;
+	case Punctuator::lessEqual: return Opcode::lessEqual;
+	case Punctuator::greater: return Opcode::greater;
+	case Punctuator::greaterEqual: return Opcode::greaterEqual;
+	case Punctuator::shiftLeft: return Opcode::shiftLeft;
+	case Punctuator::shiftRight: return Opcode::shiftRight;
+	case Punctuator::plus: return Opcode::add;
+	case Punctuator::minus: return Opcode::subtract;
+	case Punctuator::star: return Opcode::multiply;
+	case Punctuator::slash: return Opcode::divide;
+	default: return Opcode::modulo;
+	}
+}
+
+// Queries like __has_include(<file>) can not be answered by the lexer so evaluate to 0.
+bool IsQueryBuiltin(std::string_view name) noexcept {
+	constexpr std::string_view queries[] = {
+		"__has_include", "__has_include_next", "__has_attribute", "__has_cpp_attribute",
+		"__has_c_attribute", "__has_builtin", "__has_feature", "__has_extension",
+	};
+	return std::find(std::begin(queries), std::end(queries), name) != std::end(queries);
+}
+
+class ExpressionCompiler {
+	const SymbolTable &symbols;
+	const CharacterSet &setWordStart;
+	// Limits stop recursive or exponentially growing macros and deeply nested expressions
+	static constexpr int maximumDepth = 100;
+	static constexpr size_t maximumTokens = 10000;
+	std::vector<std::string_view> expanding;
+	PPTokens tokens;
+	size_t current = 0;
+	int depth = 0;
+	bool failed = false;
+	std::vector<Instruction> program;
+
+	bool Expanding(std::string_view name) const noexcept {
+		return std::find(expanding.begin(), expanding.end(), name) != expanding.end();
+	}
+	static size_t SkipBracketed(const PPTokens &input, size_t i) noexcept {
+		// i is at '(', return index after matching ')'
+		int nest = 0;
+		for (; i < input.size(); i++) {
+			if (input[i].Is(Punctuator::leftParen)) {
+				nest++;
+			} else if (input[i].Is(Punctuator::rightParen)) {
+				nest--;
+				if (nest == 0)
+					return i + 1;
+			}
+		}
+		return i;
+	}
+	void ExpandMacro(std::string_view name, const Symbol &symbol, const std::vector<PPTokens> &arguments, PPTokens &output);
+	void Expand(const PPTokens &input, PPTokens &output);
+
+	const PPToken *Current() const noexcept {
+		return (current < tokens.size()) ? &tokens[current] : nullptr;
+	}
+	bool Accept(Punctuator p) noexcept {
+		if (Current() && Current()->Is(p)) {
+			current++;
+			return true;
+		}
+		return false;
+	}
+	void Emit(Opcode opcode, int64_t value = 0) {
+		program.push_back({ opcode, value });
+	}
+	void ParseExpression();
+	void ParseConditional();
+	void ParseBinary(int precedence);
+	void ParseUnary();
+public:
+	ExpressionCompiler(const SymbolTable &symbols_, const CharacterSet &setWordStart_) noexcept :
+		symbols(symbols_), setWordStart(setWordStart_) {
+	}
+	bool Compile(std::string_view expression);
+	bool Evaluate(int64_t &result) const;
+};
+
+void ExpressionCompiler::ExpandMacro(std::string_view name, const Symbol &symbol, const std::vector<PPTokens> &arguments, PPTokens &output) {
+	PPTokens body;
+	TokenizeExpression(symbol.value, setWordStart, body);
+	if (symbol.IsMacro()) {
+		// Parameter names as views into symbol.arguments
+		std::vector<std::string_view> parameters;
+		std::string_view args = symbol.arguments;
+		while (!args.empty()) {
+			const size_t comma = std::min(args.find(','), args.length());
+			std::string_view parameter = args.substr(0, comma);
+			while (!parameter.empty() && IsSpaceOrTab(parameter.front()))
+				parameter.remove_prefix(1);
+			while (!parameter.empty() && IsSpaceOrTab(parameter.back()))
+				parameter.remove_suffix(1);
+			parameters.push_back((parameter == "...") ? "__VA_ARGS__" : parameter);
+			args.remove_prefix(std::min(comma + 1, args.length()));
+		}
+		PPTokens substituted;
+		for (const PPToken &token : body) {
+			const auto itParameter = (token.kind == PPToken::Kind::identifier) ?
+				std::find(parameters.begin(), parameters.end(), token.text) : parameters.end();
+			const size_t parameter = itParameter - parameters.begin();
+			if (parameter < arguments.size()) {
+				substituted.insert(substituted.end(), arguments[parameter].begin(), arguments[parameter].end());
+			} else if (itParameter != parameters.end()) {
+				// Missing argument is empty
+			} else {
+				substituted.push_back(token);
+			}
+		}
+		body.swap(substituted);
+	}
+	// Rescan with this macro disabled
+	expanding.push_back(name);
+	Expand(body, output);
+	expanding.pop_back();
+}
+
+void ExpressionCompiler::Expand(const PPTokens &input, PPTokens &output) {
+	depth++;
+	if (depth > maximumDepth) {
+		failed = true;
+	}
+	for (size_t i = 0; (i < input.size()) && !failed; i++) {
+		const PPToken &token = input[i];
+		if (output.size() > maximumTokens) {
+			failed = true;
+		} else if (token.kind != PPToken::Kind::identifier) {
+			output.push_back(token);
+		} else if (token.text == "defined") {
+			// defined identifier or defined ( identifier )
+			size_t next = i + 1;
+			const bool bracketed = (next < input.size()) && input[next].Is(Punctuator::leftParen);
+			if (bracketed)
+				next++;
+			int64_t value = 0;
+			if ((next < input.size()) && (input[next].kind == PPToken::Kind::identifier)) {
+				value = symbols.Find(input[next].text) ? 1 : 0;
+				next++;
+			}
+			if (bracketed && (next < input.size()) && input[next].Is(Punctuator::rightParen))
+				next++;
+			output.push_back(PPToken::Number(value));
+			i = next - 1;
+		} else {
+			const std::optional<Symbol> symbol = Expanding(token.text) ? std::optional<Symbol>() : symbols.Find(token.text);
+			const bool invoked = (i + 1 < input.size()) && input[i + 1].Is(Punctuator::leftParen);
+			if (symbol && !symbol->IsMacro()) {
+				ExpandMacro(token.text, *symbol, {}, output);
+			} else if (symbol && invoked) {
+				// Split arguments at top level commas then expand each before substitution
+				const size_t end = SkipBracketed(input, i + 1);
+				std::vector<PPTokens> arguments(1);
+				int nest = 0;
+				for (size_t arg = i + 2; arg < end; arg++) {
+					const PPToken &argToken = input[arg];
+					if (argToken.Is(Punctuator::leftParen)) {
+						nest++;
+					} else if (argToken.Is(Punctuator::rightParen)) {
+						if (nest == 0)
+							break;
+						nest--;
+					} else if (argToken.Is(Punctuator::comma) && (nest == 0)) {
+						arguments.emplace_back();
+						continue;
+					}
+					arguments.back().push_back(argToken);
+				}
+				for (PPTokens &argument : arguments) {
+					PPTokens expanded;
+					Expand(argument, expanded);
+					argument.swap(expanded);
+				}
+				if (symbol->arguments.find("...") != std::string_view::npos) {
+					// Variadic: join the trailing arguments back together for __VA_ARGS__
+					const size_t named = std::count(symbol->arguments.begin(), symbol->arguments.end(), ',');
+					while (arguments.size() > named + 1) {
+						PPTokens &last = arguments[arguments.size() - 2];
+						PPToken comma;
+						comma.kind = PPToken::Kind::punctuator;
+						comma.punctuator = Punctuator::comma;
+						last.push_back(comma);
+						last.insert(last.end(), arguments.back().begin(), arguments.back().end());
+						arguments.pop_back();
+					}
+				}
+				ExpandMacro(token.text, *symbol, arguments, output);
+				i = end - 1;
+			} else if (!symbol && invoked && IsQueryBuiltin(token.text)) {
+				output.push_back(PPToken::Number(0));
+				i = SkipBracketed(input, i + 1) - 1;
+			} else {
+				// Undefined identifiers and function-like macros without arguments are 0
+				output.push_back(PPToken::Number(0));
+			}
+		}
+	}
+	depth--;
+}
+
+void ExpressionCompiler::ParseExpression() {
+	ParseConditional();
+	while (!failed && Accept(Punctuator::comma)) {
+		ParseConditional();
+		Emit(Opcode::comma);
+	}
+}
+
+void ExpressionCompiler::ParseConditional() {
+	ParseBinary(precedenceLowest);
+	if (!failed && Accept(Punctuator::question)) {
+		ParseExpression();
+		if (!Accept(Punctuator::colon)) {
+			failed = true;
+			return;
+		}
+		ParseConditional();
+		Emit(Opcode::conditional);
+	}
+}
+
+void ExpressionCompiler::ParseBinary(int precedence) {
+	if (precedence > precedenceHighest) {
+		ParseUnary();
+		return;
+	}
+	ParseBinary(precedence + 1);
+	while (!failed && Current() && (Current()->kind == PPToken::Kind::punctuator) &&
+		(BinaryPrecedence(Current()->punctuator) == precedence)) {
+		const Opcode opcode = BinaryOpcode(Current()->punctuator);
+		current++;
+		ParseBinary(precedence + 1);
+		Emit(opcode);
+	}
+}
+
+void ExpressionCompiler::ParseUnary() {
+	const PPToken *token = Current();
+	depth++;
+	if (!token || (depth > maximumDepth)) {
+		failed = true;
+	} else if (token->kind == PPToken::Kind::number) {
+		current++;
+		Emit(Opcode::push, token->value);
+	} else if (Accept(Punctuator::leftParen)) {
+		ParseExpression();
+		if (!Accept(Punctuator::rightParen))
+			failed = true;
+	} else if (Accept(Punctuator::plus)) {
+		ParseUnary();
+	} else if (Accept(Punctuator::minus)) {
+		ParseUnary();
+		Emit(Opcode::negate);
+	} else if (Accept(Punctuator::exclamation)) {
+		ParseUnary();
+		Emit(Opcode::logicalNot);
+	} else if (Accept(Punctuator::tilde)) {
+		ParseUnary();
+		Emit(Opcode::complement);
+	} else {
+		failed = true;
+	}
+	depth--;
+}
+
+bool ExpressionCompiler::Compile(std::string_view expression) {
+	PPTokens raw;
+	TokenizeExpression(expression, setWordStart, raw);
+	Expand(raw, tokens);
+	if (!failed) {
+		ParseExpression();
+	}
+	// Everything must be consumed
+	if (current < tokens.size())
+		failed = true;
+	return !failed;
+}
+
+bool ExpressionCompiler::Evaluate(int64_t &result) const {
+	if (failed)
+		return false;
+	// Arithmetic is performed on unsigned values to wrap on overflow
+	std::vector<int64_t> stack;
+	for (const Instruction &instruction : program) {
+		if (instruction.opcode == Opcode::push) {
+			stack.push_back(instruction.value);
+			continue;
+		}
+		const uint64_t b = stack.back();
+		const int64_t sb = stack.back();
+		switch (instruction.opcode) {
+		case Opcode::negate: stack.back() = static_cast<int64_t>(0 - b); continue;
+		case Opcode::logicalNot: stack.back() = !sb; continue;
+		case Opcode::complement: stack.back() = static_cast<int64_t>(~b); continue;
+		default: break;
+		}
+		stack.pop_back();
+		const uint64_t a = stack.back();
+		const int64_t sa = stack.back();
+		int64_t value = 0;
+		switch (instruction.opcode) {
+		case Opcode::multiply: value = static_cast<int64_t>(a * b); break;
+		case Opcode::divide:
+		case Opcode::modulo:
+			// Division by zero treated as division by one
+			if (sb == 0)
+				value = (instruction.opcode == Opcode::divide) ? sa : 0;
+			else if (sb == -1)
+				value = (instruction.opcode == Opcode::divide) ? static_cast<int64_t>(0 - a) : 0;
+			else
+				value = (instruction.opcode == Opcode::divide) ? sa / sb : sa % sb;
+			break;
+		case Opcode::add: value = static_cast<int64_t>(a + b); break;
+		case Opcode::subtract: value = static_cast<int64_t>(a - b); break;
+		case Opcode::shiftLeft:
+			value = (sb >= 0 && sb < 64) ? static_cast<int64_t>(a << sb) : 0;
+			break;
+		case Opcode::shiftRight:
+			if (sb >= 0 && sb < 64)
+				value = (sa < 0) ? ~(~sa >> sb) : (sa >> sb);
+			else
+				value = (sa < 0) ? -1 : 0;
+			break;
+		case Opcode::less: value = sa < sb; break;
+		case Opcode::lessEqual: value = sa <= sb; break;
+		case Opcode::greater: value = sa > sb; break;
+		case Opcode::greaterEqual: value = sa >= sb; break;
+		case Opcode::equal: value = sa == sb; break;
+		case Opcode::notEqual: value = sa != sb; break;
+		case Opcode::bitAnd: value = static_cast<int64_t>(a & b); break;
+		case Opcode::bitXor: value = static_cast<int64_t>(a ^ b); break;
+		case Opcode::bitOr: value = static_cast<int64_t>(a | b); break;
+		case Opcode::logicalAnd: value = sa && sb; break;
+		case Opcode::logicalOr: value = sa || sb; break;
+		case Opcode::comma: value = sb; break;
+		case Opcode::conditional: {
+				stack.pop_back();
+				const int64_t condition = stack.back();
+				value = condition ? sa : sb;
+			}
+			break;
+		default: break;
+		}
+		stack.back() = value;
+	}
+	result = stack.empty() ? 0 : stack.back();
+	return !stack.empty();
+}
+
 // An individual named option for use in an OptionSet
 
 // Options used for LexerCPP
@@ -331,6 +1195,7 @@ struct OptionsCPP {
 	bool identifiersAllowDollars;
 	bool trackPreprocessor;
 	bool updatePreprocessor;
+	std::string macroDatabase;
 	bool verbatimStringsAllowEscapes;
 	bool triplequotedStrings;
 	bool hashquotedStrings;
@@ -353,6 +1218,7 @@ struct OptionsCPP {
 		identifiersAllowDollars = true;
 		trackPreprocessor = true;
 		updatePreprocessor = true;
+		macroDatabase = "";
 		verbatimStringsAllowEscapes = false;
 		triplequotedStrings = false;
 		hashquotedStrings = false;
@@ -399,6 +1265,12 @@ struct OptionSetCPP : public OptionSet<OptionsCPP> {
 		DefineProperty("lexer.cpp.update.preprocessor", &OptionsCPP::updatePreprocessor,
 			"Set to 1 to update preprocessor definitions when #define found.");
 
+		DefineProperty("lexer.cpp.macro.database", &OptionsCPP::macroDatabase,
+			"Path of a file of preprocessor definitions compiled by scripts/MacroDatabase.py. "
+			"These are used before the preprocessor definitions word list and "
+			"the file is shared by all lexers that use it. "
+			"Setting the property again rereads the file if it has changed.");
+
 		DefineProperty("lexer.cpp.verbatim.strings.allow.escapes", &OptionsCPP::verbatimStringsAllowEscapes,
 			"Set to 1 to allow verbatim strings to contain escape sequences.");
 
@@ -491,59 +1363,84 @@ LexicalClass lexicalClasses[] = {
 
 const int sizeLexicalClasses = static_cast<int>(std::size(lexicalClasses));
 
-}
-
-class LexerCPP : public ILexer5 {
+// Settings from properties, word lists, and substyles that do not depend on the document.
+// Shared between a lexer and its clones and copied before any of them changes it.
+struct ConfigurationCPP {
 	bool caseSensitive;
 	CharacterSet setWord;
-	CharacterSet setNegationOp;
-	CharacterSet setAddOp;
-	CharacterSet setMultOp;
-	CharacterSet setRelOp;
-	CharacterSet setLogicalOp;
-	CharacterSet setWordStart;
-	PPStates vlls;
-	std::vector<PPDefinition> ppDefineHistory;
 	WordList keywords;
 	WordList keywords2;
 	WordList keywords3;
 	WordList keywords4;
 	WordList ppDefinitions;
 	WordList markerList;
-	struct SymbolValue {
-		std::string value;
-		std::string arguments;
-		SymbolValue() noexcept = default;
-		SymbolValue(const std::string &value_, const std::string &arguments_) : value(value_), arguments(arguments_) {
-		}
-		SymbolValue &operator = (const std::string &value_) {
-			value = value_;
-			arguments.clear();
-			return *this;
-		}
-		bool IsMacro() const noexcept {
-			return !arguments.empty();
-		}
-	};
-	typedef std::map<std::string, SymbolValue> SymbolTable;
-	SymbolTable preprocessorDefinitionsStart;
+	std::shared_ptr<const MacroDatabase> macroDatabase;
+	// Built from macroDatabase and ppDefinitions whenever either changes
+	std::shared_ptr<const InitialDefinitions> initialDefinitions;
 	OptionsCPP options;
 	OptionSetCPP osCPP;
+	SubStyles subStyles;
+	explicit ConfigurationCPP(bool caseSensitive_) :
+		caseSensitive(caseSensitive_),
+		setWord(CharacterSet::setAlphaNum, "._", true),
+		subStyles(styleSubable, 0x80, 0x40, inactiveFlag) {
+		DefineInitial();
+	}
+	void DefineInitial() {
+		initialDefinitions = std::make_shared<const InitialDefinitions>(macroDatabase, ppDefinitions);
+	}
+	WordList *WordListAt(int n) noexcept {
+		switch (n) {
+		case 0:
+			return &keywords;
+		case 1:
+			return &keywords2;
+		case 2:
+			return &keywords3;
+		case 3:
+			return &keywords4;
+		case 4:
+			return &ppDefinitions;
+		case 5:
+			return &markerList;
+		default:
+			return nullptr;
+		}
+	}
+};
+
+}
+
+class LexerCPP : public ILexer5 {
+	std::shared_ptr<ConfigurationCPP> configuration;
+	CharacterSet setWordStart;
+	PPStates vlls;
+	// Definitions found in the document over the configuration's initial definitions
+	SymbolTable preprocessorDefinitions;
+	// Results of #if and #elif keyed by symbol table fingerprint and expression text
+	std::map<std::pair<uint64_t, std::string>, bool> conditionResults;
 	EscapeSequence escapeSeq;
-	SparseState<std::string> rawStringTerminators;
+	SparseState<RawStringTerminator> rawStringTerminators;
+	FoldHints foldHints;
+	LineCheckpoints<CheckpointCPP> checkpoints;
 	enum { ssIdentifier, ssDocKeyword };
-	SubStyles subStyles;
 	std::string returnBuffer;
+	explicit LexerCPP(std::shared_ptr<ConfigurationCPP> configuration_) :
+		configuration(std::move(configuration_)) {
+		preprocessorDefinitions.SetInitial(configuration->initialDefinitions);
+	}
+	// Copy the configuration if it is shared with another lexer before changing it.
+	// Checkpoints recorded with the previous configuration are discarded.
+	ConfigurationCPP &MutableConfiguration() {
+		checkpoints.Clear();
+		if (configuration.use_count() > 1) {
+			configuration = std::make_shared<ConfigurationCPP>(*configuration);
+		}
+		return *configuration;
+	}
 public:
 	explicit LexerCPP(bool caseSensitive_) :
-		caseSensitive(caseSensitive_),
-		setWord(CharacterSet::setAlphaNum, "._", true),
-		setNegationOp(CharacterSet::setNone, "!"),
-		setAddOp(CharacterSet::setNone, "+-"),
-		setMultOp(CharacterSet::setNone, "*/%"),
-		setRelOp(CharacterSet::setNone, "=!<>"),
-		setLogicalOp(CharacterSet::setNone, "|&"),
-		subStyles(styleSubable, 0x80, 0x40, inactiveFlag) {
+		LexerCPP(std::make_shared<ConfigurationCPP>(caseSensitive_)) {
 	}
 	// Deleted so LexerCPP objects can not be copied.
 	LexerCPP(const LexerCPP &) = delete;
@@ -559,23 +1456,27 @@ public:
 		return lvRelease5;
 	}
 	const char * SCI_METHOD PropertyNames() override {
-		return osCPP.PropertyNames();
+		return configuration->osCPP.PropertyNames();
 	}
 	int SCI_METHOD PropertyType(const char *name) override {
-		return osCPP.PropertyType(name);
+		return configuration->osCPP.PropertyType(name);
 	}
 	const char * SCI_METHOD DescribeProperty(const char *name) override {
-		return osCPP.DescribeProperty(name);
+		return configuration->osCPP.DescribeProperty(name);
 	}
 	Sci_Position SCI_METHOD PropertySet(const char *key, const char *val) override;
 	const char * SCI_METHOD DescribeWordListSets() override {
-		return osCPP.DescribeWordListSets();
+		return configuration->osCPP.DescribeWordListSets();
 	}
 	Sci_Position SCI_METHOD WordListSet(int n, const char *wl) override;
 	void SCI_METHOD Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 	void SCI_METHOD Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 
-	void * SCI_METHOD PrivateCall(int, void *) noexcept override {
+	void * SCI_METHOD PrivateCall(int operation, void *) override {
+		if (operation == privateCallClone) {
+			ILexer5 *clone = new LexerCPP(configuration);
+			return clone;
+		}
 		return nullptr;
 	}
 
@@ -584,16 +1485,16 @@ public:
 	}
 
 	int SCI_METHOD AllocateSubStyles(int styleBase, int numberStyles) override {
-		return subStyles.Allocate(styleBase, numberStyles);
+		return MutableConfiguration().subStyles.Allocate(styleBase, numberStyles);
 	}
 	int SCI_METHOD SubStylesStart(int styleBase) override {
-		return subStyles.Start(styleBase);
+		return configuration->subStyles.Start(styleBase);
 	}
 	int SCI_METHOD SubStylesLength(int styleBase) override {
-		return subStyles.Length(styleBase);
+		return configuration->subStyles.Length(styleBase);
 	}
 	int SCI_METHOD StyleFromSubStyle(int subStyle) override {
-		const int styleBase = subStyles.BaseStyle(MaskActive(subStyle));
+		const int styleBase = configuration->subStyles.BaseStyle(MaskActive(subStyle));
 		const int inactive = subStyle & inactiveFlag;
 		return styleBase | inactive;
 	}
@@ -601,10 +1502,10 @@ public:
 		return MaskActive(style);
 	}
 	void SCI_METHOD FreeSubStyles() override {
-		subStyles.Free();
+		MutableConfiguration().subStyles.Free();
 	}
 	void SCI_METHOD SetIdentifiers(int style, const char *identifiers) override {
-		subStyles.SetIdentifiers(style, identifiers);
+		MutableConfiguration().subStyles.SetIdentifiers(style, identifiers);
 	}
 	int SCI_METHOD DistanceToSecondaryStyles() noexcept override {
 		return inactiveFlag;
@@ -613,7 +1514,7 @@ public:
 		return styleSubable;
 	}
 	int SCI_METHOD NamedStyles() override {
-		return std::max(subStyles.LastAllocated() + 1,
+		return std::max(configuration->subStyles.LastAllocated() + 1,
 			sizeLexicalClasses) +
 			inactiveFlag;
 	}
@@ -629,6 +1530,7 @@ public:
 		if (style >= NamedStyles())
 			return "Excess";
 		returnBuffer.clear();
+		const SubStyles &subStyles = configuration->subStyles;
 		const int firstSubStyle = subStyles.FirstAllocated();
 		if (firstSubStyle >= 0) {
 			const int lastSubStyle = subStyles.LastAllocated();
@@ -668,10 +1570,10 @@ public:
 
 	// ILexer5 methods
 	const char * SCI_METHOD GetName() override {
-		return caseSensitive ? "cpp" : "cppnocase";
+		return configuration->caseSensitive ? "cpp" : "cppnocase";
 	}
 	int SCI_METHOD  GetIdentifier() override {
-		return caseSensitive ? SCLEX_CPP : SCLEX_CPPNOCASE;
+		return configuration->caseSensitive ? SCLEX_CPP : SCLEX_CPPNOCASE;
 	}
 	const char * SCI_METHOD PropertyGet(const char *key) override;
 
@@ -684,18 +1586,41 @@ public:
 	constexpr static int MaskActive(int style) noexcept {
 		return style & ~inactiveFlag;
 	}
-	void EvaluateTokens(Tokens &tokens, const SymbolTable &preprocessorDefinitions);
-	Tokens Tokenize(const std::string &expr) const;
 	bool EvaluateExpression(const std::string &expr, const SymbolTable &preprocessorDefinitions);
+	void HintPreprocessor(LexAccessor &styler, Sci_PositionU position, Sci_PositionU endPos, Sci_Position line);
+	void HintInterruptedComment(const LexAccessor &styler, Sci_Position line);
+	void FoldFromHints(LexAccessor &styler, Sci_PositionU startPos, Sci_PositionU endPos);
 };
 
 Sci_Position SCI_METHOD LexerCPP::PropertySet(const char *key, const char *val) {
-	if (osCPP.PropertySet(&options, key, val)) {
+	// Setting the database path again reopens the file if it has been regenerated since
+	const bool isDatabase = strcmp(key, "lexer.cpp.macro.database") == 0;
+	std::shared_ptr<const MacroDatabase> database;
+	if (isDatabase) {
+		database = MacroDatabase::Open(val);
+	}
+	const bool databaseChanged = isDatabase && (database != configuration->macroDatabase);
+	if ((configuration.use_count() > 1) && !databaseChanged) {
+		// Avoid copying a shared configuration for an unknown or unchanged property
+		const char *current = configuration->osCPP.PropertyGet(key);
+		if (!current || (*current && (strcmp(current, val) == 0))) {
+			return -1;
+		}
+	}
+	ConfigurationCPP &config = MutableConfiguration();
+	if (config.osCPP.PropertySet(&config.options, key, val) || databaseChanged) {
+		// Hints were found with the previous options
+		foldHints.Clear();
 		if (strcmp(key, "lexer.cpp.allow.dollars") == 0) {
-			setWord = CharacterSet(CharacterSet::setAlphaNum, "._", true);
-			if (options.identifiersAllowDollars) {
-				setWord.Add('$');
+			config.setWord = CharacterSet(CharacterSet::setAlphaNum, "._", true);
+			if (config.options.identifiersAllowDollars) {
+				config.setWord.Add('$');
 			}
+			conditionResults.clear();
+		} else if (isDatabase) {
+			config.macroDatabase = std::move(database);
+			config.DefineInitial();
+			preprocessorDefinitions.SetInitial(config.initialDefinitions);
 		}
 		return 0;
 	}
@@ -703,65 +1628,23 @@ Sci_Position SCI_METHOD LexerCPP::PropertySet(const char *key, const char *val)
 }
 
 const char * SCI_METHOD LexerCPP::PropertyGet(const char *key) {
-	return osCPP.PropertyGet(key);
+	return configuration->osCPP.PropertyGet(key);
 }
 
 Sci_Position SCI_METHOD LexerCPP::WordListSet(int n, const char *wl) {
-	WordList *wordListN = nullptr;
-	switch (n) {
-	case 0:
-		wordListN = &keywords;
-		break;
-	case 1:
-		wordListN = &keywords2;
-		break;
-	case 2:
-		wordListN = &keywords3;
-		break;
-	case 3:
-		wordListN = &keywords4;
-		break;
-	case 4:
-		wordListN = &ppDefinitions;
-		break;
-	case 5:
-		wordListN = &markerList;
-		break;
-	default:
-		break;
-	}
+	const WordList *wordListCurrent = configuration->WordListAt(n);
 	Sci_Position firstModification = -1;
-	if (wordListN) {
-		WordList wlNew;
-		wlNew.Set(wl);
-		if (*wordListN != wlNew) {
-			wordListN->Set(wl);
+	if (wordListCurrent) {
+		// Set a copy so a shared configuration is only copied when the list changes
+		WordList wordListN(*wordListCurrent);
+		if (wordListN.Set(wl)) {
+			ConfigurationCPP &config = MutableConfiguration();
+			*config.WordListAt(n) = wordListN;
 			firstModification = 0;
 			if (n == 4) {
 				// Rebuild preprocessorDefinitions
-				preprocessorDefinitionsStart.clear();
-				for (int nDefinition = 0; nDefinition < ppDefinitions.Length(); nDefinition++) {
-					const char *cpDefinition = ppDefinitions.WordAt(nDefinition);
-					const char *cpEquals = strchr(cpDefinition, '=');
-					if (cpEquals) {
-						std::string name(cpDefinition, cpEquals - cpDefinition);
-						std::string val(cpEquals+1);
-						const size_t bracket = name.find('(');
-						const size_t bracketEnd = name.find(')');
-						if ((bracket != std::string::npos) && (bracketEnd != std::string::npos)) {
-							// Macro
-							std::string args = name.substr(bracket + 1, bracketEnd - bracket - 1);
-							name = name.substr(0, bracket);
-							preprocessorDefinitionsStart[name] = SymbolValue(val, args);
-						} else {
-							preprocessorDefinitionsStart[name] = val;
-						}
-					} else {
-						std::string name(cpDefinition);
-						std::string val("1");
-						preprocessorDefinitionsStart[name] = val;
-					}
-				}
+				config.DefineInitial();
+				preprocessorDefinitions.SetInitial(config.initialDefinitions);
 			}
 		}
 	}
@@ -771,6 +1654,17 @@ Sci_Position SCI_METHOD LexerCPP::WordListSet(int n, const char *wl) {
 void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
 	LexAccessor styler(pAccess);
 
+	const ConfigurationCPP &config = *configuration;
+	const OptionsCPP &options = config.options;
+	const bool caseSensitive = config.caseSensitive;
+	const CharacterSet &setWord = config.setWord;
+	const WordList &keywords = config.keywords;
+	const WordList &keywords2 = config.keywords2;
+	const WordList &keywords3 = config.keywords3;
+	const WordList &keywords4 = config.keywords4;
+	const WordList &markerList = config.markerList;
+	const SubStyles &subStyles = config.subStyles;
+
 	const CharacterSet setOKBeforeRE(CharacterSet::setNone, "([{=,:;!%^&*|?~+-");
 	const CharacterSet setCouldBePostOp(CharacterSet::setNone, "+-");
 
@@ -818,34 +1712,14 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 		}
 	}
 
-	StyleContext sc(startPos, length, initStyle, styler);
 	LinePPState preproc = vlls.ForLine(lineCurrent);
 
-	bool definitionsChanged = false;
+	// Discard definitions from the current line onwards or, when not updating,
+	// all definitions from the document
+	bool definitionsChanged = preprocessorDefinitions.Truncate(options.updatePreprocessor ? lineCurrent : 0);
 
-	// Truncate ppDefineHistory before current line
-
-	if (!options.updatePreprocessor)
-		ppDefineHistory.clear();
-
-	const std::vector<PPDefinition>::iterator itInvalid = std::find_if(
-		ppDefineHistory.begin(), ppDefineHistory.end(),
-		[lineCurrent](const PPDefinition &p) noexcept { return p.line >= lineCurrent; });
-	if (itInvalid != ppDefineHistory.end()) {
-		ppDefineHistory.erase(itInvalid, ppDefineHistory.end());
-		definitionsChanged = true;
-	}
-
-	SymbolTable preprocessorDefinitions = preprocessorDefinitionsStart;
-	for (const PPDefinition &ppDef : ppDefineHistory) {
-		if (ppDef.isUndef)
-			preprocessorDefinitions.erase(ppDef.key);
-		else
-			preprocessorDefinitions[ppDef.key] = SymbolValue(ppDef.value, ppDef.arguments);
-	}
-
-	std::string rawStringTerminator = rawStringTerminators.ValueAt(lineCurrent-1);
-	SparseState<std::string> rawSTNew(lineCurrent);
+	RawStringTerminator rawStringTerminator = rawStringTerminators.ValueAt(lineCurrent-1);
+	SparseState<RawStringTerminator> rawSTNew(lineCurrent);
 
 	int activitySet = preproc.ActiveState();
 
@@ -854,6 +1728,52 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 
 	Sci_PositionU lineEndNext = styler.LineEnd(lineCurrent);
 
+	// Record fold level changes while the characters are classified so Fold need not
+	// examine them again. Explicit markers anywhere are not limited to comments so
+	// those ranges are left for Fold to scan.
+	const bool foldHinting = options.fold && !options.foldExplicitAnywhere;
+	const bool hintComments = foldHinting && options.foldComment && options.foldCommentMultiline;
+	const bool hintMarkers = foldHinting && options.foldComment && options.foldCommentExplicit;
+	const bool hintPreprocessor = foldHinting && options.foldPreprocessor;
+	const bool hintBraces = foldHinting && options.foldSyntaxBased;
+	const bool userDefinedFoldMarkers = !options.foldExplicitStart.empty() && !options.foldExplicitEnd.empty();
+	const Sci_PositionU endPos = startPos + length;
+	if (foldHinting) {
+		foldHints.Start(pAccess, styler.Length(), startPos, endPos, lineCurrent);
+	} else {
+		foldHints.Clear();
+	}
+
+	// Within a long line, resume from the last checkpoint before any change
+	CheckpointCPP checkpoint = {initStyle, 0, chPrevNonWhite, visibleChars,
+		styleBeforeDCKeyword, styleBeforeTaskMarker, activitySet,
+		lastWordWasUUID, continuationLine, isIncludePreprocessor, isStringInPreprocessor,
+		inRERange, seenDocKeyBrace, rawStringTerminator, 0, 0};
+	const Sci_PositionU resumePos = checkpoints.Resume(styler, startPos, endPos, checkpoint);
+	if (resumePos != startPos) {
+		chPrevNonWhite = checkpoint.chPrevNonWhite;
+		visibleChars = checkpoint.visibleChars;
+		styleBeforeDCKeyword = checkpoint.styleBeforeDCKeyword;
+		styleBeforeTaskMarker = checkpoint.styleBeforeTaskMarker;
+		activitySet = checkpoint.activitySet;
+		lastWordWasUUID = checkpoint.lastWordWasUUID;
+		continuationLine = checkpoint.continuationLine;
+		isIncludePreprocessor = checkpoint.isIncludePreprocessor;
+		isStringInPreprocessor = checkpoint.isStringInPreprocessor;
+		inRERange = checkpoint.inRERange;
+		seenDocKeyBrace = checkpoint.seenDocKeyBrace;
+		rawStringTerminator = checkpoint.rawStringTerminator;
+		if (foldHinting) {
+			foldHints.Resume(lineCurrent, checkpoint.foldNext, checkpoint.foldMinimum);
+		}
+	}
+	// Checkpoints are not recorded after a directive as its definitions and
+	// conditions are not part of the checkpoint
+	Sci_Position lineDirective = -1;
+
+	StyleContext sc(resumePos, endPos - resumePos, checkpoint.state, styler);
+	sc.chPrev = checkpoint.chPrev;
+
 	for (; sc.More();) {
 
 		if (sc.atLineStart) {
@@ -883,7 +1803,7 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 			lineCurrent++;
 			lineEndNext = styler.LineEnd(lineCurrent);
 			vlls.Add(lineCurrent, preproc);
-			if (!rawStringTerminator.empty()) {
+			if (!rawStringTerminator.Empty()) {
 				rawSTNew.Set(lineCurrent-1, rawStringTerminator);
 			}
 		}
@@ -894,7 +1814,7 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 				lineCurrent++;
 				lineEndNext = styler.LineEnd(lineCurrent);
 				vlls.Add(lineCurrent, preproc);
-				if (!rawStringTerminator.empty()) {
+				if (!rawStringTerminator.Empty()) {
 					rawSTNew.Set(lineCurrent-1, rawStringTerminator);
 				}
 				sc.Forward();
@@ -1014,15 +1934,25 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 				break;
 			case SCE_C_COMMENT:
 				if (sc.Match('*', '/')) {
+					if (hintComments && (sc.currentPos + 2 < static_cast<Sci_PositionU>(styler.Length()))) {
+						foldHints.Close(sc.currentLine);
+					}
 					sc.Forward();
 					sc.ForwardSetState(SCE_C_DEFAULT|activitySet);
 				} else {
 					styleBeforeTaskMarker = SCE_C_COMMENT;
 					highlightTaskMarker(sc, styler, activitySet, markerList, caseSensitive);
+					if (hintComments && (MaskActive(sc.state) == SCE_C_TASKMARKER) && !sc.atLineStart) {
+						// Task marker interrupts the comment
+						foldHints.Close(sc.currentLine);
+					}
 				}
 				break;
 			case SCE_C_COMMENTDOC:
 				if (sc.Match('*', '/')) {
+					if (hintComments && (sc.currentPos + 2 < static_cast<Sci_PositionU>(styler.Length()))) {
+						foldHints.Close(sc.currentLine);
+					}
 					sc.Forward();
 					sc.ForwardSetState(SCE_C_DEFAULT|activitySet);
 				} else if (sc.ch == '@' || sc.ch == '\\') { // JavaDoc and Doxygen support
@@ -1062,6 +1992,9 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 				break;
 			case SCE_C_COMMENTDOCKEYWORD:
 				if ((styleBeforeDCKeyword == SCE_C_COMMENTDOC) && sc.Match('*', '/')) {
+					if (hintComments && (sc.currentPos + 2 < static_cast<Sci_PositionU>(styler.Length()))) {
+						foldHints.Close(sc.currentLine);
+					}
 					sc.ChangeState(SCE_C_COMMENTDOCKEYWORDERROR);
 					sc.Forward();
 					sc.ForwardSetState(SCE_C_DEFAULT|activitySet);
@@ -1082,6 +2015,9 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 						const int subStyleCDKW = classifierDocKeyWords.ValueFor(s+1);
 						if (subStyleCDKW >= 0) {
 							sc.ChangeState(subStyleCDKW|activitySet);
+							if (hintComments && (styleBeforeDCKeyword == SCE_C_COMMENTDOC)) {
+								HintInterruptedComment(styler, sc.currentLine);
+							}
 						} else {
 							sc.ChangeState(SCE_C_COMMENTDOCKEYWORDERROR|activitySet);
 						}
@@ -1099,6 +2035,9 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 						const int subStyleCDKW = classifierDocKeyWords.ValueFor(s + 1);
 						if (subStyleCDKW >= 0) {
 							sc.ChangeState(subStyleCDKW | activitySet);
+							if (hintComments && (styleBeforeDCKeyword == SCE_C_COMMENTDOC)) {
+								HintInterruptedComment(styler, sc.currentLine);
+							}
 						} else {
 							sc.ChangeState(SCE_C_COMMENTDOCKEYWORDERROR | activitySet);
 						}
@@ -1157,11 +2096,10 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 				}
 				break;
 			case SCE_C_STRINGRAW:
-				if (sc.Match(rawStringTerminator.c_str())) {
-					for (size_t termPos=rawStringTerminator.size(); termPos; termPos--)
-						sc.Forward();
+				if (rawStringTerminator.Matches(styler, sc.currentPos)) {
+					sc.Forward(rawStringTerminator.Length());
 					sc.SetState(SCE_C_DEFAULT|activitySet);
-					rawStringTerminator.clear();
+					rawStringTerminator.Clear();
 				}
 				break;
 			case SCE_C_CHARACTER:
@@ -1227,6 +2165,9 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 				break;
 			case SCE_C_TASKMARKER:
 				if (isoperator(sc.ch) || IsASpace(sc.ch)) {
+					if (hintComments && (styleBeforeTaskMarker == SCE_C_COMMENT)) {
+						foldHints.Open(sc.currentLine, false);
+					}
 					sc.SetState(styleBeforeTaskMarker|activitySet);
 					styleBeforeTaskMarker = SCE_C_DEFAULT;
 				}
@@ -1243,6 +2184,14 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 
 		// Determine if a new state should be entered.
 		if (MaskActive(sc.state) == SCE_C_DEFAULT) {
+			if (checkpoints.Due(sc.currentPos) && (sc.ch != '\\') && (lineDirective != lineCurrent)) {
+				// Between tokens so lexing can resume here
+				checkpoints.Add(styler, sc.currentPos, {sc.state, sc.chPrev, chPrevNonWhite, visibleChars,
+					styleBeforeDCKeyword, styleBeforeTaskMarker, activitySet,
+					lastWordWasUUID, continuationLine, isIncludePreprocessor, isStringInPreprocessor,
+					inRERange, seenDocKeyBrace, rawStringTerminator,
+					foldHints.Next(sc.currentLine), foldHints.Minimum(sc.currentLine)});
+			}
 			if (sc.Match('@', '\"')) {
 				sc.SetState(SCE_C_VERBATIM|activitySet);
 				sc.Forward();
@@ -1254,7 +2203,8 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 				sc.Forward();
 			} else if (options.backQuotedStrings && sc.Match('`')) {
 				sc.SetState(SCE_C_STRINGRAW|activitySet);
-				rawStringTerminator = "`";
+				rawStringTerminator.Clear();
+				rawStringTerminator.Append('`');
 			} else if (IsADigit(sc.ch) || (sc.ch == '.' && IsADigit(sc.chNext))) {
 				if (lastWordWasUUID) {
 					sc.SetState(SCE_C_UUID|activitySet);
@@ -1275,6 +2225,9 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 				} else {
 					sc.SetState(SCE_C_COMMENT|activitySet);
 				}
+				if (hintComments) {
+					foldHints.Open(sc.currentLine, false);
+				}
 				sc.Forward();	// Eat the * so it isn't used for the end of the comment
 			} else if (sc.Match('/', '/')) {
 				if ((sc.Match("///") && !sc.Match("////")) || sc.Match("//!"))
@@ -1294,14 +2247,15 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 					styler.Flush();
 					if (MaskActive(styler.StyleAt(sc.currentPos - 1)) == SCE_C_STRINGRAW) {
 						sc.SetState(SCE_C_STRINGRAW|activitySet);
-						rawStringTerminator = ")";
+						rawStringTerminator.Clear();
+						rawStringTerminator.Append(')');
 						for (Sci_Position termPos = sc.currentPos + 1;; termPos++) {
 							const char chTerminator = styler.SafeGetCharAt(termPos, '(');
-							if (chTerminator == '(')
+							if ((chTerminator == '(') || rawStringTerminator.Overflowed())
 								break;
-							rawStringTerminator += chTerminator;
+							rawStringTerminator.Append(chTerminator);
 						}
-						rawStringTerminator += '\"';
+						rawStringTerminator.Append('\"');
 					} else {
 						sc.SetState(SCE_C_STRING|activitySet);
 					}
@@ -1316,6 +2270,10 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 			} else if (sc.ch == '#' && visibleChars == 0) {
 				// Preprocessor commands are alone on their line
 				sc.SetState(SCE_C_PREPROCESSOR|activitySet);
+				lineDirective = lineCurrent;
+				if (hintPreprocessor) {
+					HintPreprocessor(styler, sc.currentPos, endPos, sc.currentLine);
+				}
 				// Skip whitespace between # and preprocessor word
 				do {
 					sc.Forward();
@@ -1330,7 +2288,7 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 							const bool isIfDef = sc.Match("ifdef");
 							const int startRest = isIfDef ? 5 : 6;
 							const std::string restOfLine = GetRestOfLine(styler, sc.currentPos + startRest + 1, false);
-							const bool foundDef = preprocessorDefinitions.find(restOfLine) != preprocessorDefinitions.end();
+							const bool foundDef = preprocessorDefinitions.Find(restOfLine).has_value();
 							preproc.StartSection(isIfDef == foundDef);
 						} else if (sc.Match("if")) {
 							const std::string restOfLine = GetRestOfLine(styler, sc.currentPos + 2, true);
@@ -1408,8 +2366,7 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 									std::string value;
 									if (startValue < restOfLine.length())
 										value = restOfLine.substr(startValue);
-									preprocessorDefinitions[key] = SymbolValue(value, args);
-									ppDefineHistory.push_back(PPDefinition(lineCurrent, key, value, false, args));
+									preprocessorDefinitions.Define(lineCurrent, key, SymbolValue(value, args));
 									definitionsChanged = true;
 								} else {
 									// Value
@@ -1419,19 +2376,19 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 									std::string value = restOfLine.substr(startValue);
 									if (OnlySpaceOrTab(value))
 										value = "1";	// No value defaults to 1
-									preprocessorDefinitions[key] = value;
-									ppDefineHistory.push_back(PPDefinition(lineCurrent, key, value));
+									preprocessorDefinitions.Define(lineCurrent, key, SymbolValue(value, ""));
 									definitionsChanged = true;
 								}
 							}
 						} else if (sc.Match("undef")) {
 							if (options.updatePreprocessor && preproc.IsActive()) {
 								const std::string restOfLine = GetRestOfLine(styler, sc.currentPos + 5, false);
-								Tokens tokens = Tokenize(restOfLine);
-								if (!tokens.empty()) {
-									const std::string key = tokens[0];
-									preprocessorDefinitions.erase(key);
-									ppDefineHistory.push_back(PPDefinition(lineCurrent, key, "", true));
+								size_t endName = 0;
+								while ((endName < restOfLine.length()) && setWord.Contains(restOfLine[endName]))
+									endName++;
+								if (!restOfLine.empty()) {
+									const std::string key = restOfLine.substr(0, std::max<size_t>(endName, 1));
+									preprocessorDefinitions.Undefine(lineCurrent, key);
 									definitionsChanged = true;
 								}
 							}
@@ -1440,6 +2397,13 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 				}
 			} else if (isoperator(sc.ch)) {
 				sc.SetState(SCE_C_OPERATOR|activitySet);
+				if (hintBraces) {
+					if (sc.ch == '{' || sc.ch == '[' || sc.ch == '(') {
+						foldHints.Open(sc.currentLine, options.foldAtElse);
+					} else if (sc.ch == '}' || sc.ch == ']' || sc.ch == ')') {
+						foldHints.Close(sc.currentLine);
+					}
+				}
 			}
 		}
 
@@ -1454,6 +2418,25 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 			chPrevNonWhite = sc.ch;
 			visibleChars++;
 		}
+		if (hintMarkers && (MaskActive(sc.state) == SCE_C_COMMENTLINE)) {
+			if (userDefinedFoldMarkers) {
+				if (styler.Match(sc.currentPos, options.foldExplicitStart.c_str())) {
+					foldHints.Open(sc.currentLine, false);
+				} else if (styler.Match(sc.currentPos, options.foldExplicitEnd.c_str())) {
+					foldHints.Close(sc.currentLine);
+				}
+			} else if ((sc.ch == '/') && (sc.chNext == '/')) {
+				const char chNext2 = styler.SafeGetCharAt(sc.currentPos + 2);
+				if (chNext2 == '{') {
+					foldHints.Open(sc.currentLine, false);
+				} else if (chNext2 == '}') {
+					foldHints.Close(sc.currentLine);
+				}
+			}
+		} else if (hintPreprocessor && (sc.ch == '#') && (MaskActive(sc.state) == SCE_C_PREPROCESSOR)) {
+			// '#' within a directive such as the stringizing operator
+			HintPreprocessor(styler, sc.currentPos, endPos, sc.currentLine);
+		}
 		continuationLine = false;
 		sc.Forward();
 	}
@@ -1461,6 +2444,7 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 	if (definitionsChanged || rawStringsChanged)
 		styler.ChangeLexerState(startPos, startPos + length);
 	sc.Complete();
+	checkpoints.Styled(styler);
 }
 
 // Store both the current line's fold level and the next lines in the
@@ -1469,12 +2453,18 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 
 void SCI_METHOD LexerCPP::Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
 
+	const OptionsCPP &options = configuration->options;
 	if (!options.fold)
 		return;
 
 	LexAccessor styler(pAccess);
 
 	const Sci_PositionU endPos = startPos + length;
+	if (foldHints.Covers(pAccess, styler.Length(), startPos, endPos)) {
+		FoldFromHints(styler, startPos, endPos);
+		return;
+	}
+
 	int visibleChars = 0;
 	bool inLineComment = false;
 	Sci_Position lineCurrent = styler.GetLine(startPos);
@@ -1525,17 +2515,12 @@ void SCI_METHOD LexerCPP::Fold(Sci_PositionU startPos, Sci_Position length, int
 		}
 		if (options.foldPreprocessor && (style == SCE_C_PREPROCESSOR)) {
 			if (ch == '#') {
-				Sci_PositionU j = i + 1;
-				while ((j < endPos) && IsASpaceOrTab(styler.SafeGetCharAt(j))) {
-					j++;
-				}
-				if (styler.Match(j, "region") || styler.Match(j, "if")) {
+				const PreprocessorFold preprocessorFold = PreprocessorFoldAt(styler, i, endPos);
+				if (preprocessorFold == PreprocessorFold::start) {
 					levelNext++;
-				} else if (styler.Match(j, "end")) {
+				} else if (preprocessorFold == PreprocessorFold::end) {
 					levelNext--;
-				}
-
-				if (options.foldPreprocessorAtElse && (styler.Match(j, "else") || styler.Match(j, "elif"))) {
+				} else if (options.foldPreprocessorAtElse && (preprocessorFold == PreprocessorFold::middle)) {
 					levelMinCurrent--;
 				}
 			}
@@ -1583,239 +2568,90 @@ void SCI_METHOD LexerCPP::Fold(Sci_PositionU startPos, Sci_Position length, int
 	}
 }
 
-void LexerCPP::EvaluateTokens(Tokens &tokens, const SymbolTable &preprocessorDefinitions) {
-
-	// Remove whitespace tokens
-	tokens.erase(std::remove_if(tokens.begin(), tokens.end(), OnlySpaceOrTab), tokens.end());
-
-	// Evaluate defined statements to either 0 or 1
-	for (size_t i=0; (i+1)<tokens.size();) {
-		if (tokens[i] == "defined") {
-			const char *val = "0";
-			if (tokens[i+1] == "(") {
-				if (((i + 2)<tokens.size()) && (tokens[i + 2] == ")")) {
-					// defined()
-					tokens.erase(tokens.begin() + i + 1, tokens.begin() + i + 3);
-				} else if (((i+3)<tokens.size()) && (tokens[i+3] == ")")) {
-					// defined(<identifier>)
-					const SymbolTable::const_iterator it = preprocessorDefinitions.find(tokens[i+2]);
-					if (it != preprocessorDefinitions.end()) {
-						val = "1";
-					}
-					tokens.erase(tokens.begin() + i + 1, tokens.begin() + i + 4);
-				} else {
-					// Spurious '(' so erase as more likely to result in false
-					tokens.erase(tokens.begin() + i + 1, tokens.begin() + i + 2);
-				}
-			} else {
-				// defined <identifier>
-				const SymbolTable::const_iterator it = preprocessorDefinitions.find(tokens[i+1]);
-				if (it != preprocessorDefinitions.end()) {
-					val = "1";
-				}
-				tokens.erase(tokens.begin() + i + 1, tokens.begin() + i + 2);
-			}
-			tokens[i] = val;
-		} else {
-			i++;
-		}
-	}
-
-	// Evaluate identifiers
-	constexpr size_t maxIterations = 100;
-	size_t iterations = 0;	// Limit number of iterations in case there is a recursive macro.
-	for (size_t i = 0; (i<tokens.size()) && (iterations < maxIterations);) {
-		iterations++;
-		if (setWordStart.Contains(tokens[i][0])) {
-			const SymbolTable::const_iterator it = preprocessorDefinitions.find(tokens[i]);
-			if (it != preprocessorDefinitions.end()) {
-				// Tokenize value
-				Tokens macroTokens = Tokenize(it->second.value);
-				if (it->second.IsMacro()) {
-					if ((i + 1 < tokens.size()) && (tokens.at(i + 1) == "(")) {
-						// Create map of argument name to value
-						const Tokens argumentNames = StringSplit(it->second.arguments, ',');
-						std::map<std::string, std::string> arguments;
-						size_t arg = 0;
-						size_t tok = i+2;
-						while ((tok < tokens.size()) && (arg < argumentNames.size()) && (tokens.at(tok) != ")")) {
-							if (tokens.at(tok) != ",") {
-								arguments[argumentNames.at(arg)] = tokens.at(tok);
-								arg++;
-							}
-							tok++;
-						}
-
-						// Remove invocation
-						tokens.erase(tokens.begin() + i, tokens.begin() + tok + 1);
-
-						// Substitute values into macro
-						macroTokens.erase(std::remove_if(macroTokens.begin(), macroTokens.end(), OnlySpaceOrTab), macroTokens.end());
-
-						for (size_t iMacro = 0; iMacro < macroTokens.size();) {
-							if (setWordStart.Contains(macroTokens[iMacro][0])) {
-								const std::map<std::string, std::string>::const_iterator itFind =
-									arguments.find(macroTokens[iMacro]);
-								if (itFind != arguments.end()) {
-									// TODO: Possible that value will be expression so should insert tokenized form
-									macroTokens[iMacro] = itFind->second;
-								}
-							}
-							iMacro++;
-						}
-
-						// Insert results back into tokens
-						tokens.insert(tokens.begin() + i, macroTokens.begin(), macroTokens.end());
-
-					} else {
-						i++;
-					}
-				} else {
-					// Remove invocation
-					tokens.erase(tokens.begin() + i);
-					// Insert results back into tokens
-					tokens.insert(tokens.begin() + i, macroTokens.begin(), macroTokens.end());
-				}
-			} else {
-				// Identifier not found and value defaults to zero
-				tokens[i] = "0";
-			}
-		} else {
-			i++;
-		}
-	}
-
-	// Find bracketed subexpressions and recurse on them
-	BracketPair bracketPair = FindBracketPair(tokens);
-	while (bracketPair.itBracket != tokens.end()) {
-		Tokens inBracket(bracketPair.itBracket + 1, bracketPair.itEndBracket);
-		EvaluateTokens(inBracket, preprocessorDefinitions);
-
-		// The insertion is done before the removal because there were failures with the opposite approach
-		tokens.insert(bracketPair.itBracket, inBracket.begin(), inBracket.end());
-
-		bracketPair = FindBracketPair(tokens);
-		tokens.erase(bracketPair.itBracket, bracketPair.itEndBracket + 1);
-
-		bracketPair = FindBracketPair(tokens);
-	}
-
-	// Evaluate logical negations
-	for (size_t j=0; (j+1)<tokens.size();) {
-		if (setNegationOp.Contains(tokens[j][0])) {
-			int isTrue = atoi(tokens[j+1].c_str());
-			if (tokens[j] == "!")
-				isTrue = !isTrue;
-			const Tokens::iterator itInsert =
-				tokens.erase(tokens.begin() + j, tokens.begin() + j + 2);
-			tokens.insert(itInsert, isTrue ? "1" : "0");
-		} else {
-			j++;
-		}
+void LexerCPP::HintPreprocessor(LexAccessor &styler, Sci_PositionU position, Sci_PositionU endPos, Sci_Position line) {
+	switch (PreprocessorFoldAt(styler, position, endPos)) {
+	case PreprocessorFold::start:
+		foldHints.Open(line, false);
+		break;
+	case PreprocessorFold::end:
+		foldHints.Close(line);
+		break;
+	case PreprocessorFold::middle:
+		if (configuration->options.foldPreprocessorAtElse)
+			foldHints.Middle(line);
+		break;
+	default:
+		break;
 	}
+}
 
-	// Evaluate expressions in precedence order
-	enum precedence { precMult, precAdd, precRelative
-		, precLogical, /* end marker */ precLast };
-	for (int prec = precMult; prec < precLast; prec++) {
-		// Looking at 3 tokens at a time so end at 2 before end
-		for (size_t k=0; (k+2)<tokens.size();) {
-			const char chOp = tokens[k+1][0];
-			if (
-				((prec==precMult) && setMultOp.Contains(chOp)) ||
-				((prec==precAdd) && setAddOp.Contains(chOp)) ||
-				((prec==precRelative) && setRelOp.Contains(chOp)) ||
-				((prec==precLogical) && setLogicalOp.Contains(chOp))
-				) {
-				const int valA = atoi(tokens[k].c_str());
-				const int valB = atoi(tokens[k+2].c_str());
-				int result = 0;
-				if (tokens[k+1] == "+")
-					result = valA + valB;
-				else if (tokens[k+1] == "-")
-					result = valA - valB;
-				else if (tokens[k+1] == "*")
-					result = valA * valB;
-				else if (tokens[k+1] == "/")
-					result = valA / (valB ? valB : 1);
-				else if (tokens[k+1] == "%")
-					result = valA % (valB ? valB : 1);
-				else if (tokens[k+1] == "<")
-					result = valA < valB;
-				else if (tokens[k+1] == "<=")
-					result = valA <= valB;
-				else if (tokens[k+1] == ">")
-					result = valA > valB;
-				else if (tokens[k+1] == ">=")
-					result = valA >= valB;
-				else if (tokens[k+1] == "==")
-					result = valA == valB;
-				else if (tokens[k+1] == "!=")
-					result = valA != valB;
-				else if (tokens[k+1] == "||")
-					result = valA || valB;
-				else if (tokens[k+1] == "&&")
-					result = valA && valB;
-				const Tokens::iterator itInsert =
-					tokens.erase(tokens.begin() + k, tokens.begin() + k + 3);
-				tokens.insert(itInsert, std::to_string(result));
-			} else {
-				k++;
-			}
-		}
+// A sub-styled documentation keyword is not a comment style so it ends the comment
+// which then starts again after the keyword. Fold does not see the comment end when
+// the keyword starts its line.
+void LexerCPP::HintInterruptedComment(const LexAccessor &styler, Sci_Position line) {
+	if (styler.GetStartSegment() != static_cast<Sci_PositionU>(styler.LineStart(line))) {
+		foldHints.Close(line);
 	}
+	foldHints.Open(line, false);
 }
 
-Tokens LexerCPP::Tokenize(const std::string &expr) const {
-	// Break into tokens
-	Tokens tokens;
-	const char *cp = expr.c_str();
-	while (*cp) {
-		std::string word;
-		if (setWord.Contains(*cp)) {
-			// Identifiers and numbers
-			while (setWord.Contains(*cp)) {
-				word += *cp;
-				cp++;
-			}
-		} else if (IsSpaceOrTab(*cp)) {
-			while (IsSpaceOrTab(*cp)) {
-				word += *cp;
-				cp++;
-			}
-		} else if (setRelOp.Contains(*cp)) {
-			word += *cp;
-			cp++;
-			if (setRelOp.Contains(*cp)) {
-				word += *cp;
-				cp++;
-			}
-		} else if (setLogicalOp.Contains(*cp)) {
-			word += *cp;
-			cp++;
-			if (setLogicalOp.Contains(*cp)) {
-				word += *cp;
-				cp++;
+// Fold the range just lexed from the level changes Lex recorded for each line.
+void LexerCPP::FoldFromHints(LexAccessor &styler, Sci_PositionU startPos, Sci_PositionU endPos) {
+	if (startPos >= endPos)
+		return;
+	Sci_Position lineCurrent = styler.GetLine(startPos);
+	const Sci_Position lineLast = styler.GetLine(endPos - 1);
+	int levelCurrent = SC_FOLDLEVELBASE;
+	if (lineCurrent > 0)
+		levelCurrent = styler.LevelAt(lineCurrent-1) >> 16;
+	const OptionsCPP &options = configuration->options;
+	const bool useMinimum = (options.foldSyntaxBased && options.foldAtElse) ||
+		(options.foldPreprocessor && options.foldPreprocessorAtElse);
+	Sci_PositionU lineStart = startPos;
+	for (; lineCurrent <= lineLast; lineCurrent++) {
+		const Sci_PositionU lineStartNext = styler.LineStart(lineCurrent+1);
+		const int levelUse = levelCurrent + (useMinimum ? foldHints.Minimum(lineCurrent) : 0);
+		const int levelNext = levelCurrent + foldHints.Next(lineCurrent);
+		int lev = levelUse | levelNext << 16;
+		if (options.foldCompact) {
+			const Sci_PositionU lineEnd = std::min(lineStartNext, endPos);
+			Sci_PositionU i = lineStart;
+			while ((i < lineEnd) && IsASpace(styler[i])) {
+				i++;
 			}
-		} else {
-			// Should handle strings, characters, and comments here
-			word += *cp;
-			cp++;
+			if (i == lineEnd)
+				lev |= SC_FOLDLEVELWHITEFLAG;
+		}
+		if (levelUse < levelNext)
+			lev |= SC_FOLDLEVELHEADERFLAG;
+		if (lev != styler.LevelAt(lineCurrent)) {
+			styler.SetLevel(lineCurrent, lev);
 		}
-		tokens.push_back(word);
+		levelCurrent = levelNext;
+		lineStart = lineStartNext;
+	}
+	if (endPos == static_cast<Sci_PositionU>(styler.Length())) {
+		// There is an empty line at end of file so give it same level and empty
+		styler.SetLevel(lineCurrent, (levelCurrent | levelCurrent << 16) | SC_FOLDLEVELWHITEFLAG);
 	}
-	return tokens;
 }
 
 bool LexerCPP::EvaluateExpression(const std::string &expr, const SymbolTable &preprocessorDefinitions) {
-	Tokens tokens = Tokenize(expr);
-
-	EvaluateTokens(tokens, preprocessorDefinitions);
-
-	// "0" or "" -> false else true
-	const bool isFalse = tokens.empty() ||
-		((tokens.size() == 1) && (tokens[0].empty() || tokens[0] == "0"));
-	return !isFalse;
+	const std::pair<uint64_t, std::string> key(preprocessorDefinitions.Fingerprint(), expr);
+	const auto it = conditionResults.find(key);
+	if (it != conditionResults.end())
+		return it->second;
+
+	// Invalid expressions are false
+	ExpressionCompiler compiler(preprocessorDefinitions, setWordStart);
+	int64_t value = 0;
+	const bool isTrue = compiler.Compile(expr) && compiler.Evaluate(value) && (value != 0);
+
+	constexpr size_t maximumCachedResults = 4000;
+	if (conditionResults.size() >= maximumCachedResults)
+		conditionResults.clear();
+	conditionResults.emplace(key, isTrue);
+	return isTrue;
 }
 
 LexerModule lmCPP(SCLEX_CPP, LexerCPP::LexerFactoryCPP, "cpp", cppWordLists);
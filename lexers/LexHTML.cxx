@@ -12,10 +12,13 @@
 #include <assert.h>
 #include <ctype.h>
 
+#include <cstdint>
+
 #include <string>
 #include <string_view>
+#include <vector>
 #include <map>
-#include <set>
+#include <algorithm>
 #include <functional>
 
 #include "ILexer.h"
@@ -28,6 +31,8 @@
 #include "CharacterSet.h"
 #include "LexerModule.h"
 #include "OptionSet.h"
+#include "SparseState.h"
+#include "LineCheckpoints.h"
 #include "DefaultLexer.h"
 
 using namespace Scintilla;
@@ -72,12 +77,16 @@ void GetTextSegment(Accessor &styler, Sci_PositionU start, Sci_PositionU end, ch
 	s[i] = '\0';
 }
 
-std::string GetStringSegment(Accessor &styler, Sci_PositionU start, Sci_PositionU end) {
-	std::string s;
-	Sci_PositionU i = 0;
-	for (; (i < end - start + 1); i++) {
+void GetStringSegment(Accessor &styler, Sci_PositionU start, Sci_PositionU end, std::string &s) {
+	s.clear();
+	for (Sci_PositionU i = 0; (i < end - start + 1); i++) {
 		s.push_back(MakeLowerCase(styler[start + i]));
 	}
+}
+
+std::string GetStringSegment(Accessor &styler, Sci_PositionU start, Sci_PositionU end) {
+	std::string s;
+	GetStringSegment(styler, start, end, s);
 	return s;
 }
 
@@ -95,37 +104,68 @@ std::string GetNextWord(Accessor &styler, Sci_PositionU start) {
 	return ret;
 }
 
+bool StartsWith(const char *s, std::string_view prefix) noexcept {
+	return strncmp(s, prefix.data(), prefix.length()) == 0;
+}
+
 script_type segIsScriptingIndicator(Accessor &styler, Sci_PositionU start, Sci_PositionU end, script_type prevValue) {
 	char s[100];
 	GetTextSegment(styler, start, end, s, sizeof(s));
 	//Platform::DebugPrintf("Scripting indicator [%s]\n", s);
-	if (strstr(s, "vbs"))
-		return eScriptVBS;
-	if (strstr(s, "pyth"))
+	// Find every indicator in one pass then choose by precedence:
+	// vbs, python, JavaScript, PHP, then xml when it is only preceded by spaces.
+	bool python = false;
+	bool javaScript = false;
+	bool php = false;
+	bool xml = false;
+	bool seenXml = false;
+	bool onlySpaces = true;
+	for (const char *t = s; *t; t++) {
+		switch (*t) {
+		case 'v':
+			if (StartsWith(t, "vbs"))
+				return eScriptVBS;
+			break;
+		case 'p':
+			python = python || StartsWith(t, "pyth");
+			php = php || StartsWith(t, "php");
+			break;
+		// https://html.spec.whatwg.org/multipage/scripting.html#attr-script-type
+		// https://mimesniff.spec.whatwg.org/#javascript-mime-type
+		case 'j':
+			javaScript = javaScript || StartsWith(t, "javas") || StartsWith(t, "jscr");
+			break;
+		case 'e':
+			javaScript = javaScript || StartsWith(t, "ecmas");
+			break;
+		case 'm':
+			javaScript = javaScript || StartsWith(t, "module");
+			break;
+		case 'x':
+			if (!seenXml && StartsWith(t, "xml")) {
+				seenXml = true;
+				xml = onlySpaces;
+			}
+			break;
+		default:
+			break;
+		}
+		onlySpaces = onlySpaces && IsASpace(*t);
+	}
+	if (python)
 		return eScriptPython;
-	// https://html.spec.whatwg.org/multipage/scripting.html#attr-script-type
-	// https://mimesniff.spec.whatwg.org/#javascript-mime-type
-	if (strstr(s, "javas") || strstr(s, "ecmas") || strstr(s, "module") || strstr(s, "jscr"))
+	if (javaScript)
 		return eScriptJS;
-	if (strstr(s, "php"))
+	if (php)
 		return eScriptPHP;
-	if (strstr(s, "xml")) {
-		const char *xml = strstr(s, "xml");
-		for (const char *t=s; t<xml; t++) {
-			if (!IsASpace(*t)) {
-				return prevValue;
-			}
-		}
+	if (xml)
 		return eScriptXML;
-	}
-
 	return prevValue;
 }
 
 int PrintScriptingIndicatorOffset(Accessor &styler, Sci_PositionU start, Sci_PositionU end) {
 	int iResult = 0;
-	std::string s = GetStringSegment(styler, start, end);
-	if (0 == strncmp(s.c_str(), "php", 3)) {
+	if ((end >= start + 2) && styler.MatchIgnoreCase(start, "php")) {
 		iResult = 3;
 	}
 	return iResult;
@@ -251,13 +291,13 @@ inline bool isCommentASPState(int state) {
 	return bResult;
 }
 
-bool classifyAttribHTML(script_mode inScriptType, Sci_PositionU start, Sci_PositionU end, const WordList &keywords, Accessor &styler) {
+bool classifyAttribHTML(script_mode inScriptType, Sci_PositionU start, Sci_PositionU end, const WordList &keywords, Accessor &styler, std::string &s) {
 	char chAttr = SCE_H_ATTRIBUTEUNKNOWN;
 	bool isLanguageType = false;
 	if (IsNumberChar(styler[start])) {
 		chAttr = SCE_H_NUMBER;
 	} else {
-		const std::string s = GetStringSegment(styler, start, end);
+		GetStringSegment(styler, start, end, s);
 		if (keywords.InList(s.c_str()))
 			chAttr = SCE_H_ATTRIBUTE;
 		if (inScriptType == eNonHtmlScript) {
@@ -287,11 +327,80 @@ bool isHTMLCustomElement(const std::string &tag) {
 	return true;
 }
 
+// Tags that are handled differently to other tags.
+enum class TagKind { other, noFold, script, comment };
+
+struct SpecialTag {
+	std::string_view name;
+	TagKind kind;
+};
+
+// HTML tags that are not containers so are not folded along with script and comment
+constexpr SpecialTag specialTags[] = {
+	{ "area", TagKind::noFold },
+	{ "base", TagKind::noFold },
+	{ "basefont", TagKind::noFold },
+	{ "br", TagKind::noFold },
+	{ "col", TagKind::noFold },
+	{ "command", TagKind::noFold },
+	{ "embed", TagKind::noFold },
+	{ "frame", TagKind::noFold },
+	{ "hr", TagKind::noFold },
+	{ "img", TagKind::noFold },
+	{ "input", TagKind::noFold },
+	{ "isindex", TagKind::noFold },
+	{ "keygen", TagKind::noFold },
+	{ "link", TagKind::noFold },
+	{ "meta", TagKind::noFold },
+	{ "param", TagKind::noFold },
+	{ "source", TagKind::noFold },
+	{ "track", TagKind::noFold },
+	{ "wbr", TagKind::noFold },
+	{ "script", TagKind::script },
+	{ "comment", TagKind::comment },
+};
+
+// Perfect hash of the special tags: the multipliers were chosen so each special tag has
+// its own slot so a tag is identified by one comparison.
+class SpecialTagTable {
+	static constexpr size_t slotCount = 64;
+	// Index into specialTags plus 1 or 0 for an empty slot
+	unsigned char slots[slotCount] {};
+	static constexpr size_t Hash(std::string_view tag) noexcept {
+		return (tag.length() * 5 + static_cast<unsigned char>(tag.front()) +
+			static_cast<unsigned char>(tag.back()) * 35) % slotCount;
+	}
+public:
+	constexpr SpecialTagTable() noexcept {
+		for (size_t i = 0; i < std::size(specialTags); i++) {
+			slots[Hash(specialTags[i].name)] = static_cast<unsigned char>(i + 1);
+		}
+	}
+	constexpr bool Perfect() const noexcept {
+		size_t filled = 0;
+		for (const unsigned char slot : slots) {
+			if (slot)
+				filled++;
+		}
+		return filled == std::size(specialTags);
+	}
+	constexpr TagKind Kind(std::string_view tag) const noexcept {
+		if (tag.empty())
+			return TagKind::other;
+		const unsigned char slot = slots[Hash(tag)];
+		if (slot && (specialTags[slot - 1].name == tag))
+			return specialTags[slot - 1].kind;
+		return TagKind::other;
+	}
+};
+
+constexpr SpecialTagTable specialTagTable;
+static_assert(specialTagTable.Perfect(), "Special tags must hash to different slots");
+
 int classifyTagHTML(Sci_PositionU start, Sci_PositionU end,
                            const WordList &keywords, Accessor &styler, bool &tagDontFold,
-                    bool caseSensitive, bool isXml, bool allowScripts,
-                    const std::set<std::string> &nonFoldingTags) {
-	std::string tag;
+                    bool caseSensitive, bool isXml, bool allowScripts, std::string &tag) {
+	tag.clear();
 	// Copy after the '<' and stop before ' '
 	for (Sci_PositionU cPos = start; cPos <= end; cPos++) {
 		const char ch = styler[cPos];
@@ -305,7 +414,8 @@ int classifyTagHTML(Sci_PositionU start, Sci_PositionU end,
 	// if the current language is XML, I can fold any tag
 	// if the current language is HTML, I don't want to fold certain tags (input, meta, etc.)
 	//...to find it in the list of no-container-tags
-	tagDontFold = (!isXml) && (nonFoldingTags.count(tag) > 0);
+	const TagKind kind = specialTagTable.Kind(tag);
+	tagDontFold = (!isXml) && (kind == TagKind::noFold);
 	// No keywords -> all are known
 	char chAttr = SCE_H_TAGUNKNOWN;
 	if (!tag.empty() && (tag[0] == '!')) {
@@ -319,7 +429,7 @@ int classifyTagHTML(Sci_PositionU start, Sci_PositionU end,
 		styler.ColourTo(end, chAttr);
 	}
 	if (chAttr == SCE_H_TAG) {
-		if (allowScripts && (tag == "script")) {
+		if (allowScripts && (kind == TagKind::script)) {
 			// check to see if this is a self-closing tag by sniffing ahead
 			bool isSelfClose = false;
 			for (Sci_PositionU cPos = end; cPos <= end + 200; cPos++) {
@@ -335,7 +445,7 @@ int classifyTagHTML(Sci_PositionU start, Sci_PositionU end,
 			// do not enter a script state if the tag self-closed
 			if (!isSelfClose)
 				chAttr = SCE_H_SCRIPT;
-		} else if (!isXml && (tag == "comment")) {
+		} else if (!isXml && (kind == TagKind::comment)) {
 			chAttr = SCE_H_COMMENT;
 		}
 	}
@@ -496,6 +606,150 @@ bool isLineEnd(int ch) {
 	return ch == '\r' || ch == '\n';
 }
 
+// Mako and Django code that continues over line ends needs more than the line state to
+// resume lexing: how the block started determines how it ends.
+struct RegionCheckpoint {
+	std::string blockType;
+	script_type beforeLanguage = eScriptNone;
+	bool operator==(const RegionCheckpoint &other) const {
+		return (blockType == other.blockType) && (beforeLanguage == other.beforeLanguage);
+	}
+	bool operator!=(const RegionCheckpoint &other) const {
+		return !(*this == other);
+	}
+};
+
+// Everything Lex carries from one character to the next so lexing can resume
+// inside a long line.
+struct CheckpointHTML {
+	std::string prevWord;
+	std::string phpStringDelimiter;
+	std::string makoBlockType;
+	std::string djangoBlockType;
+	int state = SCE_H_DEFAULT;
+	int makoComment = 0;
+	script_mode inScriptType = eHtml;
+	bool tagOpened = false;
+	bool tagClosing = false;
+	bool tagDontFold = false;
+	bool isLanguageType = false;
+	script_type aspScript = eScriptNone;
+	script_type clientScript = eScriptNone;
+	script_type scriptLanguage = eScriptNone;
+	script_type beforeLanguage = eScriptNone;
+	int beforePreProc = 0;
+	int levelPrev = 0;
+	int levelCurrent = 0;
+	int visibleChars = 0;
+	int lineStartVisibleChars = 0;
+	int chPrev = ' ';
+	int ch = ' ';
+	int chPrevNonWhite = ' ';
+	bool operator==(const CheckpointHTML &other) const {
+		return (state == other.state) &&
+			(makoComment == other.makoComment) &&
+			(inScriptType == other.inScriptType) &&
+			(tagOpened == other.tagOpened) &&
+			(tagClosing == other.tagClosing) &&
+			(tagDontFold == other.tagDontFold) &&
+			(isLanguageType == other.isLanguageType) &&
+			(aspScript == other.aspScript) &&
+			(clientScript == other.clientScript) &&
+			(scriptLanguage == other.scriptLanguage) &&
+			(beforeLanguage == other.beforeLanguage) &&
+			(beforePreProc == other.beforePreProc) &&
+			(levelPrev == other.levelPrev) &&
+			(levelCurrent == other.levelCurrent) &&
+			(visibleChars == other.visibleChars) &&
+			(lineStartVisibleChars == other.lineStartVisibleChars) &&
+			(chPrev == other.chPrev) &&
+			(ch == other.ch) &&
+			(chPrevNonWhite == other.chPrevNonWhite) &&
+			(prevWord == other.prevWord) &&
+			(phpStringDelimiter == other.phpStringDelimiter) &&
+			(makoBlockType == other.makoBlockType) &&
+			(djangoBlockType == other.djangoBlockType);
+	}
+};
+
+// State at the start of a line that continues a PHP string or heredoc so lexing can
+// restart there without reading back to the start of the string.
+struct PHPStringLine {
+	Sci_Position line = -1;
+	CheckpointHTML checkpoint;
+	bool operator==(const PHPStringLine &other) const {
+		return (line == other.line) && (checkpoint == other.checkpoint);
+	}
+	bool operator!=(const PHPStringLine &other) const {
+		return !(*this == other);
+	}
+};
+
+constexpr bool IsPreProcMode(script_mode inScriptType) noexcept {
+	return (inScriptType == eNonHtmlPreProc) || (inScriptType == eNonHtmlScriptPreProc);
+}
+
+// Characters that may start markup, end the state, or end the line in the content states
+// of plain HTML and XML. All other characters continue the current style so runs of them
+// are skipped together instead of going through the state machine one at a time.
+class ContentStops {
+	const CharacterSet text = CharacterSet(CharacterSet::setNone, "<&\r\n");
+	const CharacterSet doubleString = CharacterSet(CharacterSet::setNone, "<\"\r\n");
+	const CharacterSet singleString = CharacterSet(CharacterSet::setNone, "<\'\r\n");
+	const CharacterSet markupEnd = CharacterSet(CharacterSet::setNone, "<>\r\n");
+public:
+	const CharacterSet *ForState(int state) const noexcept {
+		switch (state) {
+		case SCE_H_DEFAULT:
+			return &text;
+		case SCE_H_DOUBLESTRING:
+			return &doubleString;
+		case SCE_H_SINGLESTRING:
+			return &singleString;
+		case SCE_H_COMMENT:
+		case SCE_H_CDATA:
+			return &markupEnd;
+		default:
+			return nullptr;
+		}
+	}
+};
+
+// A run of characters that contains no stops and so does not change state.
+// Holds what the lexer needs to continue as if it had seen each character.
+struct ContentRun {
+	Sci_Position length = 0;
+	int nonSpaces = 0;
+	int last = 0;
+	int beforeLast = 0;
+	int nonSpaceBeforeLast = 0;
+};
+
+ContentRun ScanContent(LexAccessor &styler, Sci_Position position, Sci_Position end, const CharacterSet &stops) {
+	constexpr Sci_Position chunkSize = 256;
+	ContentRun run;
+	while (position < end) {
+		const Sci_Position chunk = std::min(end - position, chunkSize);
+		const char *text = styler.BufferPointer(position, chunk);
+		if (!text)
+			break;
+		for (Sci_Position k = 0; k < chunk; k++) {
+			const unsigned char ch = text[k];
+			if (stops.Contains(ch))
+				return run;
+			if ((run.length > 0) && !IsASpace(run.last))
+				run.nonSpaceBeforeLast = run.last;
+			if (!IsASpace(ch))
+				run.nonSpaces++;
+			run.beforeLast = run.last;
+			run.last = ch;
+			run.length++;
+		}
+		position += chunk;
+	}
+	return run;
+}
+
 bool isMakoBlockEnd(const int ch, const int chNext, const std::string &blockType) {
 	if (blockType.empty()) {
 		return ((ch == '%') && (chNext == '>'));
@@ -945,28 +1199,6 @@ LexicalClass lexicalClassesXML[] = {
 	31, "SCE_H_SGML_BLOCK_DEFAULT", "default", "SGML block",
 };
 
-const char *tagsThatDoNotFold[] = {
-	"area",
-	"base",
-	"basefont",
-	"br",
-	"col",
-	"command",
-	"embed",
-	"frame",
-	"hr",
-	"img",
-	"input",
-	"isindex",
-	"keygen",
-	"link",
-	"meta",
-	"param",
-	"source",
-	"track",
-	"wbr"
-};
-
 }
 
 class LexerHTML : public DefaultLexer {
@@ -980,7 +1212,11 @@ class LexerHTML : public DefaultLexer {
 	WordList keywords6; // SGML (DTD) keywords
 	OptionsHTML options;
 	OptionSetHTML osHTML;
-	std::set<std::string> nonFoldingTags;
+	// Template block at the end of each line inside Mako or Django code
+	SparseState<RegionCheckpoint> regionCheckpoints;
+	// Lines starting inside a PHP string or heredoc
+	SparseState<PHPStringLine> phpStringLines;
+	LineCheckpoints<CheckpointHTML> checkpoints;
 public:
 	explicit LexerHTML(bool isXml_, bool isPHPScript_) :
 		DefaultLexer(
@@ -990,8 +1226,7 @@ public:
 			isXml_ ?  std::size(lexicalClassesXML) : std::size(lexicalClassesHTML)),
 		isXml(isXml_),
 		isPHPScript(isPHPScript_),
-		osHTML(isPHPScript_),
-		nonFoldingTags(std::begin(tagsThatDoNotFold), std::end(tagsThatDoNotFold)) {
+		osHTML(isPHPScript_) {
 	}
 	~LexerHTML() override {
 	}
@@ -1031,6 +1266,7 @@ public:
 
 Sci_Position SCI_METHOD LexerHTML::PropertySet(const char *key, const char *val) {
 	if (osHTML.PropertySet(&options, key, val)) {
+		checkpoints.Clear();
 		return 0;
 	}
 	return -1;
@@ -1060,10 +1296,8 @@ Sci_Position SCI_METHOD LexerHTML::WordListSet(int n, const char *wl) {
 	}
 	Sci_Position firstModification = -1;
 	if (wordListN) {
-		WordList wlNew;
-		wlNew.Set(wl);
-		if (*wordListN != wlNew) {
-			wordListN->Set(wl);
+		if (wordListN->Set(wl)) {
+			checkpoints.Clear();
 			firstModification = 0;
 		}
 	}
@@ -1083,6 +1317,8 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 	int state = stateForPrintState(StateToPrint);
 	std::string makoBlockType;
 	int makoComment = 0;
+	// Reused for tag and attribute names so they do not allocate
+	std::string segment;
 	std::string djangoBlockType;
 	// If inside a tag, it may be a script tag, so reread from the start of line starting tag to ensure any language tags are seen
 	if (InTagState(state)) {
@@ -1093,8 +1329,20 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 		}
 		state = SCE_H_DEFAULT;
 	}
-	// String can be heredoc, must find a delimiter first. Reread from beginning of line containing the string, to get the correct lineState
-	if (isPHPStringState(state)) {
+	// String can be heredoc, must find a delimiter first.
+	// The whole state was recorded when the string continued onto this line.
+	// Mako comments restyle from the start of the string they are in so Mako reads back.
+	PHPStringLine stringLine;
+	bool resumeStringLine = false;
+	if (isPHPStringState(state) && !options.isMako) {
+		const Sci_Position lineFirst = styler.GetLine(startPos);
+		if ((lineFirst > 0) && (styler.LineStart(lineFirst) == static_cast<Sci_Position>(startPos))) {
+			stringLine = phpStringLines.ValueAt(lineFirst);
+			resumeStringLine = (stringLine.line == lineFirst) && (stringLine.checkpoint.state == state);
+		}
+	}
+	// When not recorded, reread from beginning of line containing the string, to get the correct lineState
+	if (isPHPStringState(state) && !resumeStringLine) {
 		while (startPos > 0 && (isPHPStringState(state) || !isLineEnd(styler[startPos - 1]))) {
 			startPos--;
 			length++;
@@ -1141,6 +1389,18 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 		scriptLanguage = eScriptComment;
 	}
 	script_type beforeLanguage = ScriptOfState(beforePreProc);
+	const bool isTemplate = options.isMako || options.isDjango;
+	if (isTemplate && (lineCurrent > 0) && IsPreProcMode(inScriptType)) {
+		// Resume inside a block that started on an earlier line
+		const RegionCheckpoint region = regionCheckpoints.ValueAt(lineCurrent - 1);
+		if (options.isMako)
+			makoBlockType = region.blockType;
+		else
+			djangoBlockType = region.blockType;
+		beforeLanguage = region.beforeLanguage;
+	}
+	SparseState<RegionCheckpoint> regionsNew(lineCurrent);
+	SparseState<PHPStringLine> phpStringLinesNew(lineCurrent);
 	const bool foldHTML = options.foldHTML;
 	const bool fold = foldHTML && options.fold;
 	const bool foldHTMLPreprocessor = foldHTML && options.foldHTMLPreprocessor;
@@ -1181,9 +1441,83 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 		}
 	}
 
-	styler.StartSegment(startPos);
+	// Mako and Django start code in content with characters that are not stops
+	const bool skipContent = !isMako && !isDjango && (styler.Encoding() != EncodingType::dbcs);
+	const ContentStops contentStops;
+
 	const Sci_Position lengthDoc = startPos + length;
-	for (Sci_Position i = startPos; i < lengthDoc; i++) {
+	CheckpointHTML checkpoint {prevWord, phpStringDelimiter, makoBlockType, djangoBlockType,
+		state, makoComment, inScriptType, tagOpened, tagClosing, tagDontFold, isLanguageType,
+		aspScript, clientScript, scriptLanguage, beforeLanguage, beforePreProc,
+		levelPrev, levelCurrent, visibleChars, lineStartVisibleChars, chPrev, ch, chPrevNonWhite};
+	if (resumeStringLine) {
+		checkpoint = stringLine.checkpoint;
+	}
+	const Sci_Position resumePos = checkpoints.Resume(styler, startPos, lengthDoc, checkpoint);
+	if (resumeStringLine || (resumePos != static_cast<Sci_Position>(startPos))) {
+		prevWord = checkpoint.prevWord;
+		phpStringDelimiter = checkpoint.phpStringDelimiter;
+		makoBlockType = checkpoint.makoBlockType;
+		djangoBlockType = checkpoint.djangoBlockType;
+		state = checkpoint.state;
+		makoComment = checkpoint.makoComment;
+		inScriptType = checkpoint.inScriptType;
+		tagOpened = checkpoint.tagOpened;
+		tagClosing = checkpoint.tagClosing;
+		tagDontFold = checkpoint.tagDontFold;
+		isLanguageType = checkpoint.isLanguageType;
+		aspScript = checkpoint.aspScript;
+		clientScript = checkpoint.clientScript;
+		scriptLanguage = checkpoint.scriptLanguage;
+		beforeLanguage = checkpoint.beforeLanguage;
+		beforePreProc = checkpoint.beforePreProc;
+		levelPrev = checkpoint.levelPrev;
+		levelCurrent = checkpoint.levelCurrent;
+		visibleChars = checkpoint.visibleChars;
+		lineStartVisibleChars = checkpoint.lineStartVisibleChars;
+		chPrev = checkpoint.chPrev;
+		ch = checkpoint.ch;
+		chPrevNonWhite = checkpoint.chPrevNonWhite;
+		styler.StartAt(resumePos);
+	}
+
+	styler.StartSegment(resumePos);
+	for (Sci_Position i = resumePos; i < lengthDoc; i++) {
+		// Record the whole state where a PHP string continues onto a new line
+		if (((ch == '\n') || (ch == '\r')) && isPHPStringState(state) && !isMako && (styler.LineStart(lineCurrent) == i)) {
+			phpStringLinesNew.Set(lineCurrent, {lineCurrent, {prevWord, phpStringDelimiter, makoBlockType, djangoBlockType,
+				state, makoComment, inScriptType, tagOpened, tagClosing, tagDontFold, isLanguageType,
+				aspScript, clientScript, scriptLanguage, beforeLanguage, beforePreProc,
+				levelPrev, levelCurrent, visibleChars, lineStartVisibleChars, chPrev, ch, chPrevNonWhite}});
+		}
+		// Between tokens of content or script and not after a '<' that may start "<!"
+		if (((state == SCE_H_DEFAULT) || (state == SCE_HJ_DEFAULT)) && (ch != '<') && checkpoints.Due(i)) {
+			checkpoints.Add(styler, i, {prevWord, phpStringDelimiter, makoBlockType, djangoBlockType,
+				state, makoComment, inScriptType, tagOpened, tagClosing, tagDontFold, isLanguageType,
+				aspScript, clientScript, scriptLanguage, beforeLanguage, beforePreProc,
+				levelPrev, levelCurrent, visibleChars, lineStartVisibleChars, chPrev, ch, chPrevNonWhite});
+		}
+		// '<' followed by '!' starts SGML so '!' must be seen by the state machine
+		if (skipContent && (inScriptType == eHtml) && (scriptLanguage == eScriptNone) && (ch != '<')) {
+			const CharacterSet *stops = contentStops.ForState(state);
+			if (stops) {
+				const ContentRun run = ScanContent(styler, i, lengthDoc, *stops);
+				if (run.length > 0) {
+					if (!IsASpace(ch))
+						chPrevNonWhite = ch;
+					if (run.nonSpaceBeforeLast)
+						chPrevNonWhite = run.nonSpaceBeforeLast;
+					chPrev = (run.length > 1) ? run.beforeLast : ch;
+					ch = run.last;
+					if (fold)
+						visibleChars += foldCompact ? run.nonSpaces : static_cast<int>(run.length);
+					lineStartVisibleChars += run.nonSpaces;
+					i += run.length;
+					if (i >= lengthDoc)
+						break;
+				}
+			}
+		}
 		const int chPrev2 = chPrev;
 		chPrev = ch;
 		if (!IsASpace(ch) && state != SCE_HJ_COMMENT &&
@@ -1291,6 +1625,9 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 			                    ((clientScript & 0x0F) << 8) |
 			                    ((beforePreProc & 0xFF) << 12) |
 			                    ((isLanguageType ? 1 : 0) << 20));
+			if (isTemplate && IsPreProcMode(inScriptType)) {
+				regionsNew.Set(lineCurrent, RegionCheckpoint{isMako ? makoBlockType : djangoBlockType, beforeLanguage});
+			}
 			lineCurrent++;
 			lineStartVisibleChars = 0;
 		}
@@ -1881,7 +2218,7 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 		case SCE_H_TAGUNKNOWN:
 			if (!setTagContinue.Contains(ch) && !((ch == '/') && (chPrev == '<'))) {
 				int eClass = classifyTagHTML(styler.GetStartSegment(),
-					i - 1, keywords, styler, tagDontFold, caseSensitive, isXml, allowScripts, nonFoldingTags);
+					i - 1, keywords, styler, tagDontFold, caseSensitive, isXml, allowScripts, segment);
 				if (eClass == SCE_H_SCRIPT || eClass == SCE_H_COMMENT) {
 					if (!tagClosing) {
 						inScriptType = eNonHtmlScript;
@@ -1935,7 +2272,7 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 			break;
 		case SCE_H_ATTRIBUTE:
 			if (!setAttributeContinue.Contains(ch)) {
-				isLanguageType = classifyAttribHTML(inScriptType, styler.GetStartSegment(), i - 1, keywords, styler);
+				isLanguageType = classifyAttribHTML(inScriptType, styler.GetStartSegment(), i - 1, keywords, styler, segment);
 				if (ch == '>') {
 					styler.ColourTo(i, SCE_H_TAG);
 					if (inScriptType == eNonHtmlScript) {
@@ -2616,12 +2953,26 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 		break;
 	}
 
+	// A string continuing onto the line after the range is recorded as it is not reached in the loop
+	if (((ch == '\n') || (ch == '\r')) && isPHPStringState(state) && !isMako && (styler.LineStart(lineCurrent) == lengthDoc)) {
+		phpStringLinesNew.Set(lineCurrent, {lineCurrent, {prevWord, phpStringDelimiter, makoBlockType, djangoBlockType,
+			state, makoComment, inScriptType, tagOpened, tagClosing, tagDontFold, isLanguageType,
+			aspScript, clientScript, scriptLanguage, beforeLanguage, beforePreProc,
+			levelPrev, levelCurrent, visibleChars, lineStartVisibleChars, chPrev, ch, chPrevNonWhite}});
+	}
+
 	// Fill in the real level of the next line, keeping the current flags as they will be filled in later
 	if (fold) {
 		const int flagsNext = styler.LevelAt(lineCurrent) & ~SC_FOLDLEVELNUMBERMASK;
 		styler.SetLevel(lineCurrent, levelPrev | flagsNext);
 	}
+	// Blocks or strings changing on the lines lexed may change how following lines lex
+	const bool regionsChanged = regionCheckpoints.Merge(regionsNew, lineCurrent);
+	const bool stringsChanged = phpStringLines.Merge(phpStringLinesNew, lineCurrent);
+	if (regionsChanged || stringsChanged)
+		styler.ChangeLexerState(startPos, startPos + length);
 	styler.Flush();
+	checkpoints.Styled(styler);
 }
 
 LexerModule lmHTML(SCLEX_HTML, LexerHTML::LexerFactoryHTML, "hypertext", htmlWordListDesc);
@@ -11,7 +11,9 @@
  */
 
 #include <cstdlib>
+#include <cstdint>
 #include <cassert>
+#include <cstring>
 #include <cctype>
 #include <cstdio>
 
@@ -19,6 +21,7 @@
 #include <string_view>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <functional>
 
 #include "ILexer.h"
@@ -30,6 +33,7 @@
 #include "CharacterSet.h"
 #include "LexerModule.h"
 #include "OptionSet.h"
+#include "LineCheckpoints.h"
 #include "DefaultLexer.h"
 
 using namespace Scintilla;
@@ -104,6 +108,18 @@ struct EscapeSequence {
 	}
 };
 
+/**
+ * State carried from one character to the next between tokens so lexing can
+ * resume inside long lines
+ */
+struct CheckpointJSON {
+	int state;
+	int chPrev;
+	bool operator==(const CheckpointJSON &other) const noexcept {
+		return state == other.state && chPrev == other.chPrev;
+	}
+};
+
 struct OptionsJSON {
 	bool foldCompact;
 	bool fold;
@@ -142,6 +158,7 @@ class LexerJSON : public DefaultLexer {
 	CharacterSet setKeywordJSONLD;
 	CharacterSet setKeywordJSON;
 	CompactIRI compactIRI;
+	LineCheckpoints<CheckpointJSON> checkpoints;
 
 	static bool IsNextNonWhitespace(LexAccessor &styler, Sci_Position start, char ch) {
 		Sci_Position i = 0;
@@ -229,6 +246,7 @@ class LexerJSON : public DefaultLexer {
 	}
 	Sci_Position SCI_METHOD PropertySet(const char *key, const char *val) override {
 		if (optSetJSON.PropertySet(&options, key, val)) {
+			checkpoints.Clear();
 			return 0;
 		}
 		return -1;
@@ -248,10 +266,8 @@ class LexerJSON : public DefaultLexer {
 		}
 		Sci_Position firstModification = -1;
 		if (wordListN) {
-			WordList wlNew;
-			wlNew.Set(wl);
-			if (*wordListN != wlNew) {
-				wordListN->Set(wl);
+			if (wordListN->Set(wl)) {
+				checkpoints.Clear();
 				firstModification = 0;
 			}
 		}
@@ -281,7 +297,11 @@ void SCI_METHOD LexerJSON::Lex(Sci_PositionU startPos,
 							   int initStyle,
 							   IDocument *pAccess) {
 	LexAccessor styler(pAccess);
-	StyleContext context(startPos, length, initStyle, styler);
+	const Sci_PositionU endPos = startPos + length;
+	CheckpointJSON checkpoint = {initStyle, 0};
+	const Sci_PositionU resumePos = checkpoints.Resume(styler, startPos, endPos, checkpoint);
+	StyleContext context(resumePos, endPos - resumePos, checkpoint.state, styler);
+	context.chPrev = checkpoint.chPrev;
 	int stringStyleBefore = SCE_JSON_STRING;
 	while (context.More()) {
 		switch (context.state) {
@@ -394,6 +414,10 @@ void SCI_METHOD LexerJSON::Lex(Sci_PositionU startPos,
 				break;
 		}
 		if (context.state == SCE_JSON_DEFAULT) {
+			if (checkpoints.Due(context.currentPos)) {
+				// Between tokens so lexing can resume here
+				checkpoints.Add(styler, context.currentPos, {context.state, context.chPrev});
+			}
 			if (context.ch == '"') {
 				compactIRI.resetState();
 				context.SetState(SCE_JSON_STRING);
@@ -452,6 +476,7 @@ void SCI_METHOD LexerJSON::Lex(Sci_PositionU startPos,
 		context.Forward();
 	}
 	context.Complete();
+	checkpoints.Styled(styler);
 }
 
 void SCI_METHOD LexerJSON::Fold(Sci_PositionU startPos,
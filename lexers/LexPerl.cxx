@@ -16,7 +16,9 @@
 
 #include <string>
 #include <string_view>
+#include <vector>
 #include <map>
+#include <algorithm>
 #include <functional>
 
 #include "ILexer.h"
@@ -29,6 +31,7 @@
 #include "CharacterSet.h"
 #include "LexerModule.h"
 #include "OptionSet.h"
+#include "SparseState.h"
 #include "DefaultLexer.h"
 
 using namespace Scintilla;
@@ -152,19 +155,169 @@ static int disambiguateBareword(LexAccessor &styler, Sci_PositionU bk, Sci_Posit
 	return result;
 }
 
-static void skipWhitespaceComment(LexAccessor &styler, Sci_PositionU &p) {
+static int interpolationParent(int style) noexcept {
+	// interpolated styles are treated as part of their parent style when backtracking
+	switch (style) {
+	case SCE_PL_STRING_VAR:
+	case SCE_PL_REGEX_VAR:
+	case SCE_PL_REGSUBST_VAR:
+	case SCE_PL_BACKTICKS_VAR:
+	case SCE_PL_HERE_QQ_VAR:
+	case SCE_PL_HERE_QX_VAR:
+	case SCE_PL_STRING_QQ_VAR:
+	case SCE_PL_STRING_QX_VAR:
+	case SCE_PL_STRING_QR_VAR:
+		return style - INTERPOLATE_SHIFT;
+	default:
+		return style;
+	}
+}
+
+static bool isBacktrackedStyle(int style) noexcept {
+	// styles that Lex backtracks through to find where the construct started
+	switch (interpolationParent(style)) {
+	case SCE_PL_HERE_Q:
+	case SCE_PL_HERE_QQ:
+	case SCE_PL_HERE_QX:
+	case SCE_PL_FORMAT:
+	case SCE_PL_STRING:
+	case SCE_PL_STRING_QQ:
+	case SCE_PL_BACKTICKS:
+	case SCE_PL_STRING_QX:
+	case SCE_PL_REGEX:
+	case SCE_PL_STRING_QR:
+	case SCE_PL_REGSUBST:
+	case SCE_PL_STRING_Q:
+	case SCE_PL_STRING_QW:
+	case SCE_PL_XLAT:
+	case SCE_PL_CHARACTER:
+	case SCE_PL_NUMBER:
+	case SCE_PL_IDENTIFIER:
+	case SCE_PL_ERROR:
+	case SCE_PL_SUB_PROTOTYPE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool isWhitespaceComment(int style) noexcept {
+	return style == SCE_PL_DEFAULT || style == SCE_PL_COMMENTLINE;
+}
+
+// Context at the end of each line so that backtracking to the start of a multi-line
+// construct or to the last significant lexeme can jump over whole lines instead of
+// examining the style of every character. The style and start of constructs are
+// recorded while lexing and significant positions when skipWhitespaceComment finds them.
+class LineContexts {
+	static constexpr Sci_Position unknown = -1;
+	struct Context {
+		int style = -1;				// style of the last character
+		Sci_Position runStart = unknown;	// start of the run of that style and its interpolated form
+		Sci_Position significant = unknown;	// last position not whitespace or comment, 0 if none
+	};
+	std::vector<Context> contexts;
+	// Start of the line after the last recorded line
+	Sci_PositionU lineStartNext = 0;
+public:
+	// Forget lines from line on as they are about to be lexed again.
+	void Start(LexAccessor &styler, Sci_Position line) {
+		if (static_cast<size_t>(line) < contexts.size()) {
+			contexts.resize(line);
+		} else if (line > 0 && static_cast<size_t>(line - 1) > contexts.size()) {
+			// The line before line is filled in by Record but earlier lines are too
+			// far away to be worth examining.
+			contexts.resize(line - 1);
+		}
+		if (!contexts.empty()) {
+			lineStartNext = styler.LineStart(contexts.size());
+		}
+		contexts.reserve(styler.GetLine(styler.Length()) + 1);
+	}
+	// Record lines up to and including line, which ends before lineEnd, when its
+	// characters are styled or in the current segment which has state.
+	void Record(LexAccessor &styler, Sci_Position line, Sci_PositionU lineEnd, int state) {
+		const Sci_PositionU startSegment = styler.GetStartSegment();
+		auto styleAt = [&styler, startSegment, state](Sci_PositionU pos) {
+			return (pos >= startSegment) ? state : styler.BufferStyleAt(pos);
+		};
+		for (Sci_Position ln = static_cast<Sci_Position>(contexts.size()); ln <= line; ln++) {
+			const Sci_PositionU lineStart = (ln > 0) ? lineStartNext : 0;
+			lineStartNext = (ln == line) ? lineEnd : styler.LineStart(ln + 1);
+			const Sci_PositionU last = lineStartNext - 1;
+			Context context;
+			context.style = styleAt(last);
+			if (!isWhitespaceComment(context.style)) {
+				context.significant = last;
+			}
+			if (isBacktrackedStyle(context.style)) {
+				const int parent = interpolationParent(context.style);
+				Sci_PositionU pos = (last >= startSegment) ? std::max(startSegment, lineStart) : last;
+				while (pos > lineStart && interpolationParent(styleAt(pos - 1)) == parent) {
+					pos--;
+				}
+				context.runStart = pos;
+				if (ln > 0 && pos == lineStart && interpolationParent(styleAt(pos - 1)) == parent) {
+					const Context &previous = contexts[ln - 1];
+					context.runStart = (previous.style == styleAt(pos - 1)) ? previous.runStart : unknown;
+				}
+			}
+			contexts.push_back(context);
+		}
+	}
+	// Start of the run of style ending just before position or -1 if not known
+	// which includes when position is not at the start of a line.
+	Sci_Position RunBefore(LexAccessor &styler, Sci_PositionU position, int style) const {
+		const Sci_Position line = styler.GetLine(position) - 1;
+		if (line < 0 || static_cast<size_t>(line) >= contexts.size() || contexts[line].style != style)
+			return unknown;
+		if (static_cast<Sci_PositionU>(styler.LineStart(line + 1)) != position || styler.StyleAt(position - 1) != style)
+			return unknown;
+		return contexts[line].runStart;
+	}
+	// Last significant position at or before the end of line or -1 if not known.
+	Sci_Position Significant(Sci_Position line) const noexcept {
+		if (line < 0 || static_cast<size_t>(line) >= contexts.size())
+			return unknown;
+		return contexts[line].significant;
+	}
+	// Set the last significant position for lines from lineFirst to lineLast.
+	void SetSignificant(Sci_Position lineFirst, Sci_Position lineLast, Sci_PositionU position) noexcept {
+		for (Sci_Position ln = lineFirst; ln <= lineLast && static_cast<size_t>(ln) < contexts.size(); ln++) {
+			contexts[ln].significant = position;
+		}
+	}
+};
+
+static void skipWhitespaceComment(LexAccessor &styler, Sci_PositionU &p, LineContexts &lineContexts) {
 	// when backtracking, we need to skip whitespace and comments
+	// whole lines passed over remember where this stopped for the next search
+	Sci_Position line = -1;
+	Sci_Position lineCrossed = -1;
 	while (p > 0) {
-		const int style = styler.StyleAt(p);
-		if (style != SCE_PL_DEFAULT && style != SCE_PL_COMMENTLINE)
+		if (!isWhitespaceComment(styler.StyleAt(p)))
 			break;
+		const char chPrev = styler[p - 1];
+		if (chPrev == '\n' || (chPrev == '\r' && styler[p] != '\n')) {
+			// entering the previous line at its end
+			line = (line < 0) ? styler.GetLine(p) - 1 : line - 1;
+			if (lineCrossed < 0)
+				lineCrossed = line;
+			const Sci_Position significant = lineContexts.Significant(line);
+			if (significant >= 0) {
+				p = significant;
+				break;
+			}
+		}
 		p--;
 	}
+	if (lineCrossed >= 0)
+		lineContexts.SetSignificant(line, lineCrossed, p);
 }
 
-static int findPrevLexeme(LexAccessor &styler, Sci_PositionU &bk, int &style) {
+static int findPrevLexeme(LexAccessor &styler, Sci_PositionU &bk, int &style, LineContexts &lineContexts) {
 	// scan backward past whitespace and comments to find a lexeme
-	skipWhitespaceComment(styler, bk);
+	skipWhitespaceComment(styler, bk, lineContexts);
 	if (bk == 0)
 		return 0;
 	int sz = 1;
@@ -178,7 +331,7 @@ static int findPrevLexeme(LexAccessor &styler, Sci_PositionU &bk, int &style) {
 	return sz;
 }
 
-static int styleBeforeBracePair(LexAccessor &styler, Sci_PositionU bk) {
+static int styleBeforeBracePair(LexAccessor &styler, Sci_PositionU bk, LineContexts &lineContexts) {
 	// backtrack to find open '{' corresponding to a '}', balanced
 	// return significant style to be tested for '/' disambiguation
 	int braceCount = 1;
@@ -199,7 +352,7 @@ static int styleBeforeBracePair(LexAccessor &styler, Sci_PositionU bk) {
 	if (bk > 0 && braceCount == 0) {
 		// balanced { found, bk > 0, skip more whitespace/comments
 		bk--;
-		skipWhitespaceComment(styler, bk);
+		skipWhitespaceComment(styler, bk, lineContexts);
 		return styler.StyleAt(bk);
 	}
 	return SCE_PL_DEFAULT;
@@ -254,7 +407,7 @@ static int podLineScan(LexAccessor &styler, Sci_PositionU &pos, Sci_PositionU en
 	return state;
 }
 
-static bool styleCheckSubPrototype(LexAccessor &styler, Sci_PositionU bk) {
+static bool styleCheckSubPrototype(LexAccessor &styler, Sci_PositionU bk, LineContexts &lineContexts) {
 	// backtrack to identify if we're starting a subroutine prototype
 	// we also need to ignore whitespace/comments, format is like:
 	//     sub abc::pqr :const :prototype(...)
@@ -266,11 +419,11 @@ static bool styleCheckSubPrototype(LexAccessor &styler, Sci_PositionU bk) {
 		// find two lexemes, lexeme 2 follows lexeme 1
 		int style2 = SCE_PL_DEFAULT;
 		Sci_PositionU pos2 = bk;
-		int len2 = findPrevLexeme(styler, pos2, style2);
+		int len2 = findPrevLexeme(styler, pos2, style2, lineContexts);
 		int style1 = SCE_PL_DEFAULT;
 		Sci_PositionU pos1 = pos2;
 		if (pos1 > 0) pos1--;
-		int len1 = findPrevLexeme(styler, pos1, style1);
+		int len1 = findPrevLexeme(styler, pos1, style1, lineContexts);
 		if (len1 == 0 || len2 == 0)		// lexeme pair must exist
 			break;
 
@@ -359,6 +512,54 @@ static int PodHeadingLevel(Sci_Position pos, LexAccessor &styler) {
 	return 0;
 }
 
+class HereDocCls {	// Class to manage HERE doc sequence
+public:
+	int State = 0;
+	// 0: '<<' encountered
+	// 1: collect the delimiter
+	// 2: here doc text (lines after the delimiter)
+	int Quote = 0;			// the char after '<<'
+	bool Quoted = false;		// true if Quote in ('\'','"','`')
+	bool StripIndent = false;	// true if '<<~' requested to strip leading whitespace
+	int DelimiterLength = 0;	// Delimiter.length()
+	std::string Delimiter;		// the Delimiter
+	void Append(int ch) {
+		Delimiter.push_back(static_cast<char>(ch));
+		DelimiterLength++;
+	}
+	// Style of the body
+	int BodyStyle() const noexcept {
+		if (Quoted) {
+			switch (Quote) {
+			case '\'':
+				return SCE_PL_HERE_Q;
+			case '`':
+				return SCE_PL_HERE_QX;
+			}
+		} else if (Quote == '\\') {
+			return SCE_PL_HERE_Q;
+		}
+		return SCE_PL_HERE_QQ;
+	}
+	bool operator==(const HereDocCls &other) const noexcept {
+		return State == other.State && Quote == other.Quote && Quoted == other.Quoted &&
+			StripIndent == other.StripIndent && Delimiter == other.Delimiter;
+	}
+};
+
+// Here-docs open at the end of a line: the one whose body continues on the next
+// line followed by any others started on the same line as it. Empty when outside
+// a here-doc body.
+static std::vector<HereDocCls> openHereDocs(const HereDocCls &hereDoc, const std::vector<HereDocCls> &pending) {
+	std::vector<HereDocCls> hereDocs;
+	if (hereDoc.State == 2) {
+		hereDocs.reserve(pending.size() + 1);
+		hereDocs.push_back(hereDoc);
+		hereDocs.insert(hereDocs.end(), pending.begin(), pending.end());
+	}
+	return hereDocs;
+}
+
 // An individual named option for use in an OptionSet
 
 // Options used for LexerPerl
@@ -424,6 +625,9 @@ class LexerPerl : public DefaultLexer {
 	WordList keywords;
 	OptionsPerl options;
 	OptionSetPerl osPerl;
+	LineContexts lineContexts;
+	// Here-docs open at the end of each line so lexing can resume inside a body
+	SparseState<std::vector<HereDocCls>> hereDocs;
 public:
 	LexerPerl() :
 		DefaultLexer("perl", SCLEX_PERL),
@@ -487,10 +691,7 @@ Sci_Position SCI_METHOD LexerPerl::WordListSet(int n, const char *wl) {
 	}
 	Sci_Position firstModification = -1;
 	if (wordListN) {
-		WordList wlNew;
-		wlNew.Set(wl);
-		if (*wordListN != wlNew) {
-			wordListN->Set(wl);
+		if (wordListN->Set(wl)) {
 			firstModification = 0;
 		}
 	}
@@ -632,33 +833,8 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 	// which characters are being used as quotes, how deeply nested is the
 	// start position and what the termination string is for HERE documents.
 
-	class HereDocCls {	// Class to manage HERE doc sequence
-	public:
-		int State;
-		// 0: '<<' encountered
-		// 1: collect the delimiter
-		// 2: here doc text (lines after the delimiter)
-		int Quote;		// the char after '<<'
-		bool Quoted;		// true if Quote in ('\'','"','`')
-		bool StripIndent;	// true if '<<~' requested to strip leading whitespace
-		int DelimiterLength;	// strlen(Delimiter)
-		char Delimiter[HERE_DELIM_MAX];	// the Delimiter
-		HereDocCls() {
-			State = 0;
-			Quote = 0;
-			Quoted = false;
-			StripIndent = false;
-			DelimiterLength = 0;
-			Delimiter[0] = '\0';
-		}
-		void Append(int ch) {
-			Delimiter[DelimiterLength++] = static_cast<char>(ch);
-			Delimiter[DelimiterLength] = '\0';
-		}
-		~HereDocCls() {
-		}
-	};
-	HereDocCls HereDoc;		// TODO: FIFO for stacked here-docs
+	HereDocCls HereDoc;		// here-doc being collected or whose body is being read
+	std::vector<HereDocCls> hereDocsPending;	// further here-docs started on the same line, in order
 
 	class QuoteCls {	// Class to manage quote pairs
 	public:
@@ -688,11 +864,34 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 
 	Sci_PositionU endPos = startPos + length;
 
+	// Lines from startPos are about to change so their contexts are forgotten
+	lineContexts.Start(styler, styler.GetLine(startPos));
+
+	// Inside a here-doc body, resume from the here-docs recorded as open at the
+	// end of the previous line instead of backtracking to the delimiter.
+	bool hereDocResumed = false;
+	if (initStyle == SCE_PL_HERE_Q
+	    || initStyle == SCE_PL_HERE_QQ
+	    || initStyle == SCE_PL_HERE_QX
+	   ) {
+		const Sci_Position lineStart = styler.GetLine(startPos);
+		if (lineStart > 0 && styler.LineStart(lineStart) == static_cast<Sci_Position>(startPos)) {
+			const std::vector<HereDocCls> hereDocsOpen = hereDocs.ValueAt(lineStart - 1);
+			if (!hereDocsOpen.empty() && hereDocsOpen.front().BodyStyle() == initStyle) {
+				HereDoc = hereDocsOpen.front();
+				hereDocsPending.assign(hereDocsOpen.begin() + 1, hereDocsOpen.end());
+				hereDocResumed = true;
+			}
+		}
+	}
+
 	// Backtrack to beginning of style if required...
 	// If in a long distance lexical state, backtrack to find quote characters.
 	// Includes strings (may be multi-line), numbers (additional state), format
 	// bodies, as well as POD sections.
-	if (initStyle == SCE_PL_HERE_Q
+	if (hereDocResumed) {
+		// state already restored
+	} else if (initStyle == SCE_PL_HERE_Q
 	    || initStyle == SCE_PL_HERE_QQ
 	    || initStyle == SCE_PL_HERE_QX
 	    || initStyle == SCE_PL_FORMAT
@@ -701,6 +900,12 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 	   ) {
 		// backtrack through multiple styles to reach the delimiter start
 		int delim = (initStyle == SCE_PL_FORMAT) ? SCE_PL_FORMAT_IDENT:SCE_PL_HERE_DELIM;
+		if (startPos > 1 && styler.StyleAt(startPos) != delim) {
+			// jump over the body to the line after the delimiter when recorded
+			const Sci_Position runStart = lineContexts.RunBefore(styler, startPos, initStyle);
+			if (runStart >= 0)
+				startPos = std::max<Sci_PositionU>(runStart, 1);
+		}
 		while ((startPos > 1) && (styler.StyleAt(startPos) != delim)) {
 			startPos--;
 		}
@@ -725,6 +930,9 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 		// for interpolation, must backtrack through a mix of two different styles
 		int otherStyle = (initStyle >= SCE_PL_STRING_VAR) ?
 			initStyle - INTERPOLATE_SHIFT : initStyle + INTERPOLATE_SHIFT;
+		const Sci_Position runStart = lineContexts.RunBefore(styler, startPos, initStyle);
+		if (runStart >= 0 && startPos > 1)
+			startPos = std::max<Sci_PositionU>(runStart, 1);
 		while (startPos > 1) {
 			int st = styler.StyleAt(startPos - 1);
 			if ((st != initStyle) && (st != otherStyle))
@@ -741,6 +949,9 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 	        || initStyle == SCE_PL_ERROR
 	        || initStyle == SCE_PL_SUB_PROTOTYPE
 	   ) {
+		const Sci_Position runStart = lineContexts.RunBefore(styler, startPos, initStyle);
+		if (runStart >= 0 && startPos > 1)
+			startPos = std::max<Sci_PositionU>(runStart, 1);
 		while ((startPos > 1) && (styler.StyleAt(startPos - 1) == initStyle)) {
 			startPos--;
 		}
@@ -764,6 +975,10 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 		}
 	}
 
+	lineContexts.Start(styler, styler.GetLine(startPos));
+	SparseState<std::vector<HereDocCls>> hereDocsNew(styler.GetLine(startPos));
+	bool hereDocsChanged = true;	// so recorded for the first line then after each change
+
 	// backFlag, backPos are additional state to aid identifier corner cases.
 	// Look backwards past whitespace and comments in order to detect either
 	// operator or keyword. Later updated as we go along.
@@ -771,7 +986,7 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 	Sci_PositionU backPos = startPos;
 	if (backPos > 0) {
 		backPos--;
-		skipWhitespaceComment(styler, backPos);
+		skipWhitespaceComment(styler, backPos, lineContexts);
 		if (styler.StyleAt(backPos) == SCE_PL_OPERATOR)
 			backFlag = BACK_OPERATOR;
 		else if (styler.StyleAt(backPos) == SCE_PL_WORD)
@@ -783,6 +998,14 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 
 	for (; sc.More(); sc.Forward()) {
 
+		if (sc.atLineStart && sc.currentLine > 0) {
+			lineContexts.Record(styler, sc.currentLine - 1, sc.currentPos, sc.state);
+			if (hereDocsChanged) {
+				hereDocsNew.Set(sc.currentLine - 1, openHereDocs(HereDoc, hereDocsPending));
+				hereDocsChanged = false;
+			}
+		}
+
 		// Determine if the current state should terminate.
 		switch (sc.state) {
 		case SCE_PL_OPERATOR:
@@ -921,7 +1144,7 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 				HereDoc.Quoted = false;
 				HereDoc.StripIndent = false;
 				HereDoc.DelimiterLength = 0;
-				HereDoc.Delimiter[HereDoc.DelimiterLength] = '\0';
+				HereDoc.Delimiter.clear();
 				if (delim_ch == '~') { // was actually '<<~'
 					sc.Forward();
 					HereDoc.StripIndent = true;
@@ -998,14 +1221,15 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 				while (IsASpaceOrTab(sc.ch) && !sc.atLineEnd)
 					sc.Forward();
 			}
-			if (HereDoc.DelimiterLength == 0 || sc.Match(HereDoc.Delimiter)) {
+			if (HereDoc.DelimiterLength == 0 || sc.Match(HereDoc.Delimiter.c_str())) {
 				int c = sc.GetRelative(HereDoc.DelimiterLength);
 				if (c == '\r' || c == '\n') {	// peek first, do not consume match
 					sc.ForwardBytes(HereDoc.DelimiterLength);
 					sc.SetState(SCE_PL_DEFAULT);
 					backFlag = BACK_NONE;
 					HereDoc.State = 0;
-					if (!sc.atLineEnd)
+					hereDocsChanged = true;
+					if (!sc.atLineEnd && hereDocsPending.empty())
 						sc.Forward();
 					break;
 				}
@@ -1284,34 +1508,28 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 		}
 
 		// Must check end of HereDoc states here before default state is handled
-		if (HereDoc.State == 1 && sc.atLineEnd) {
+		if ((sc.atLineEnd || sc.Match('\r', '\n')) &&
+			(HereDoc.State == 1 || (HereDoc.State == 0 && !hereDocsPending.empty()))) {
 			// Begin of here-doc (the line after the here-doc delimiter):
 			// Lexically, the here-doc starts from the next line after the >>, but the
 			// first line of here-doc seem to follow the style of the last EOL sequence
-			int st_new = SCE_PL_HERE_QQ;
-			HereDoc.State = 2;
-			if (HereDoc.Quoted) {
-				if (sc.state == SCE_PL_HERE_DELIM) {
+			if (HereDoc.State == 1) {
+				if (HereDoc.Quoted && sc.state == SCE_PL_HERE_DELIM) {
 					// Missing quote at end of string! We are stricter than perl.
 					// Colour here-doc anyway while marking this bit as an error.
 					sc.ChangeState(SCE_PL_ERROR);
 				}
-				switch (HereDoc.Quote) {
-				case '\'':
-					st_new = SCE_PL_HERE_Q;
-					break;
-				case '"' :
-					st_new = SCE_PL_HERE_QQ;
-					break;
-				case '`' :
-					st_new = SCE_PL_HERE_QX;
-					break;
-				}
-			} else {
-				if (HereDoc.Quote == '\\')
-					st_new = SCE_PL_HERE_Q;
+				hereDocsPending.push_back(HereDoc);
 			}
-			sc.SetState(st_new);
+			// Stacked here-docs have their bodies one after another, in order,
+			// so the next body starts after the line ending the previous one
+			HereDoc = hereDocsPending.front();
+			hereDocsPending.erase(hereDocsPending.begin());
+			HereDoc.State = 2;
+			hereDocsChanged = true;
+			sc.SetState(HereDoc.BodyStyle());
+			if (!sc.atLineEnd)	// the whole of a \r\n line end takes the body style
+				sc.Forward();
 		}
 		if (HereDoc.State == 3 && sc.atLineEnd) {
 			// Start of format body.
@@ -1459,7 +1677,7 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 				styler.Flush();
 				if (styler.StyleAt(bk) == SCE_PL_DEFAULT)
 					hereDocSpace = true;
-				skipWhitespaceComment(styler, bk);
+				skipWhitespaceComment(styler, bk, lineContexts);
 				if (bk == 0) {
 					// avoid backward scanning breakage
 					preferRE = true;
@@ -1474,7 +1692,7 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 						} else if (bkch == '}') {
 							// backtrack by counting balanced brace pairs
 							// needed to test for variables like ${}, @{} etc.
-							bkstyle = styleBeforeBracePair(styler, bk);
+							bkstyle = styleBeforeBracePair(styler, bk, lineContexts);
 							if (bkstyle == SCE_PL_SCALAR
 							        || bkstyle == SCE_PL_ARRAY
 							        || bkstyle == SCE_PL_HASH
@@ -1556,6 +1774,9 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 						sc.Forward(3);
 					} else if (preferRE) {
 						sc.SetState(SCE_PL_HERE_DELIM);
+						if (HereDoc.State == 1) {	// stacked after another here-doc on this line
+							hereDocsPending.push_back(HereDoc);
+						}
 						HereDoc.State = 0;
 					} else {		// << operator
 						sc.SetState(SCE_PL_OPERATOR);
@@ -1640,7 +1861,7 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 				backFlag = BACK_NONE;
 			} else if (sc.ch == '(' && sc.currentPos > 0) {	// '(' or subroutine prototype
 				sc.Complete();
-				if (styleCheckSubPrototype(styler, sc.currentPos - 1)) {
+				if (styleCheckSubPrototype(styler, sc.currentPos - 1, lineContexts)) {
 					sc.SetState(SCE_PL_SUB_PROTOTYPE);
 					backFlag = BACK_NONE;
 				} else {
@@ -1661,7 +1882,12 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 		}
 	}
 	sc.Complete();
-	if (sc.state == SCE_PL_HERE_Q
+	if (hereDocsChanged && sc.atLineStart && sc.currentLine > 0) {
+		hereDocsNew.Set(sc.currentLine - 1, openHereDocs(HereDoc, hereDocsPending));
+	}
+	const bool hereDocsMerged = hereDocs.Merge(hereDocsNew, sc.currentLine);
+	if (hereDocsMerged
+	        || sc.state == SCE_PL_HERE_Q
 	        || sc.state == SCE_PL_HERE_QQ
 	        || sc.state == SCE_PL_HERE_QX
 	        || sc.state == SCE_PL_FORMAT) {
@@ -211,10 +211,7 @@ Sci_Position SCI_METHOD LexerABL::WordListSet(int n, const char *wl) {
    }
    Sci_Position firstModification = -1;
    if (wordListN) {
-      WordList wlNew;
-      wlNew.Set(wl);
-      if (*wordListN != wlNew) {
-         wordListN->Set(wl);
+      if (wordListN->Set(wl)) {
          firstModification = 0;
       }
    }
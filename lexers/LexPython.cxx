@@ -50,8 +50,8 @@ namespace {
    the f-string and the nesting count for the expression (# of [, (, { seen - # of
    }, ), ] seen).  f-strings may be nested (e.g. f'{ a + f"{1+2}"') so a stack of
    states and nesting counts is kept.  If a f-string expression continues beyond
-   the end of a line, this stack is saved in a std::map that maps a line number to
-   the stack at the end of that line.  std::vector is used for the stack.
+   the end of a line, this stack is saved in a FStringStateStore that maps a line
+   number to the stack at the end of that line.  std::vector is used for the stack.
 
    The PEP for f-strings is at https://www.python.org/dev/peps/pep-0498/
 */
@@ -60,6 +60,64 @@ struct SingleFStringExpState {
 	int nestingCount;
 };
 
+// Stacks of f-string expression states at the ends of lines, ordered by line.
+// Lines are added in increasing order after forgetting those being lexed again so
+// all the stacks are kept end to end in one vector instead of a node and
+// allocation for each line.
+class FStringStateStore {
+	struct LineStack {
+		Sci_Position line;
+		// Index in states of the bottom of the stack
+		size_t start;
+	};
+	std::vector<LineStack> lines;
+	std::vector<SingleFStringExpState> states;
+	std::vector<LineStack>::const_iterator Find(Sci_Position line) const {
+		return std::lower_bound(lines.begin(), lines.end(), line,
+			[](const LineStack &lineStack, Sci_Position lineFind) noexcept { return lineStack.line < lineFind; });
+	}
+public:
+	// Copy the stack at the end of line into stack which is left empty when there is none
+	void Get(Sci_Position line, std::vector<SingleFStringExpState> &stack) const {
+		stack.clear();
+		const auto it = Find(line);
+		if ((it != lines.end()) && (it->line == line)) {
+			const size_t end = ((it + 1) != lines.end()) ? (it + 1)->start : states.size();
+			stack.assign(states.begin() + it->start, states.begin() + end);
+		}
+	}
+	// Forget the stacks at the ends of line and all following lines
+	void Truncate(Sci_Position line) {
+		const auto it = Find(line);
+		if (it != lines.end()) {
+			states.resize(it->start);
+			lines.erase(it, lines.end());
+		}
+	}
+	// Add the stack at the end of line which follows all lines already added
+	void Add(Sci_Position line, const std::vector<SingleFStringExpState> &stack) {
+		if (!lines.empty() && (lines.back().line >= line)) {
+			return;
+		}
+		lines.push_back({line, states.size()});
+		states.insert(states.end(), stack.begin(), stack.end());
+	}
+};
+
+// What Fold needs to know about a line
+struct LineClass {
+	// IndentAmount including SC_FOLDLEVELWHITEFLAG for blank lines
+	int indent;
+	bool comment;
+	// Starts inside a triple quoted string
+	bool quote;
+	// Nearest line at or before this that is not blank, comment, or quote, or 0 when none
+	Sci_Position lineSignificant;
+	bool Significant() const noexcept {
+		return !(indent & SC_FOLDLEVELWHITEFLAG) && !comment && !quote;
+	}
+};
+
 /* kwCDef, kwCTypeName only used for Cython */
 enum kwType { kwOther, kwClass, kwDef, kwImport, kwCDef, kwCTypeName, kwCPDef };
 
@@ -352,7 +410,10 @@ class LexerPython : public DefaultLexer {
 	OptionSetPython osPython;
 	enum { ssIdentifier };
 	SubStyles subStyles;
-	std::map<Sci_Position, std::vector<SingleFStringExpState> > ftripleStateAtEol;
+	FStringStateStore ftripleStateAtEol;
+	// Class of each line from the start of the document, filled by Fold.
+	// Lex forgets lines from where it starts as changes are always lexed before being folded.
+	std::vector<LineClass> lineClasses;
 public:
 	explicit LexerPython() :
 		DefaultLexer("python", SCLEX_PYTHON, lexicalClasses, ELEMENTS(lexicalClasses)),
@@ -428,6 +489,7 @@ public:
 	}
 
 private:
+	LineClass ClassifyLine(Sci_Position line, Accessor &styler);
 	void ProcessLineEnd(StyleContext &sc, std::vector<SingleFStringExpState> &fstringStateStack, SingleFStringExpState *&currentFStringExp, bool &inContinuedString);
 };
 
@@ -452,10 +514,7 @@ Sci_Position SCI_METHOD LexerPython::WordListSet(int n, const char *wl) {
 	}
 	Sci_Position firstModification = -1;
 	if (wordListN) {
-		WordList wlNew;
-		wlNew.Set(wl);
-		if (*wordListN != wlNew) {
-			wordListN->Set(wl);
+		if (wordListN->Set(wl)) {
 			firstModification = 0;
 		}
 	}
@@ -481,11 +540,7 @@ void LexerPython::ProcessLineEnd(StyleContext &sc, std::vector<SingleFStringExpS
 		}
 	}
 	if (!fstringStateStack.empty()) {
-		std::pair<Sci_Position, std::vector<SingleFStringExpState> > val;
-		val.first = sc.currentLine;
-		val.second = fstringStateStack;
-
-		ftripleStateAtEol.insert(val);
+		ftripleStateAtEol.Add(sc.currentLine, fstringStateStack);
 	}
 
 	if ((sc.state == SCE_P_DEFAULT)
@@ -544,15 +599,13 @@ void SCI_METHOD LexerPython::Lex(Sci_PositionU startPos, Sci_Position length, in
 	}
 
 	// Set up fstate stack from last line and remove any subsequent ftriple at eol states
-	std::map<Sci_Position, std::vector<SingleFStringExpState> >::iterator it;
-	it = ftripleStateAtEol.find(lineCurrent - 1);
-	if (it != ftripleStateAtEol.end() && !it->second.empty()) {
-		fstringStateStack = it->second;
+	ftripleStateAtEol.Get(lineCurrent - 1, fstringStateStack);
+	if (!fstringStateStack.empty()) {
 		currentFStringExp = &fstringStateStack.back();
 	}
-	it = ftripleStateAtEol.lower_bound(lineCurrent);
-	if (it != ftripleStateAtEol.end()) {
-		ftripleStateAtEol.erase(it, ftripleStateAtEol.end());
+	ftripleStateAtEol.Truncate(lineCurrent);
+	if (lineCurrent < static_cast<Sci_Position>(lineClasses.size())) {
+		lineClasses.resize(lineCurrent);
 	}
 
 	kwType kwLast = kwOther;
@@ -893,6 +946,27 @@ static bool IsQuoteLine(Sci_Position line, const Accessor &styler) {
 	return IsPyTripleQuoteStringState(style);
 }
 
+LineClass LexerPython::ClassifyLine(Sci_Position line, Accessor &styler) {
+	if (line < static_cast<Sci_Position>(lineClasses.size())) {
+		return lineClasses[line];
+	}
+	int spaceFlags = 0;
+	LineClass lineClass {
+		styler.IndentAmount(line, &spaceFlags, nullptr),
+		IsCommentLine(line, styler),
+		IsQuoteLine(line, styler),
+		line
+	};
+	// Only extend the cache so it covers every line up to its end
+	if (line == static_cast<Sci_Position>(lineClasses.size())) {
+		if ((line > 0) && !lineClass.Significant()) {
+			lineClass.lineSignificant = lineClasses[line - 1].lineSignificant;
+		}
+		lineClasses.push_back(lineClass);
+	}
+	return lineClass;
+}
+
 
 void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, int /*initStyle - unused*/, IDocument *pAccess) {
 	if (!options.fold)
@@ -908,15 +982,18 @@ void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, i
 	// for any white space lines (needed esp. within triple quoted strings)
 	// and so we can fix any preceding fold level (which is why we go back
 	// at least one line in all cases)
-	int spaceFlags = 0;
 	Sci_Position lineCurrent = styler.GetLine(startPos);
-	int indentCurrent = styler.IndentAmount(lineCurrent, &spaceFlags, nullptr);
+	int indentCurrent = ClassifyLine(lineCurrent, styler).indent;
 	while (lineCurrent > 0) {
 		lineCurrent--;
-		indentCurrent = styler.IndentAmount(lineCurrent, &spaceFlags, nullptr);
-		if (!(indentCurrent & SC_FOLDLEVELWHITEFLAG) &&
-				(!IsCommentLine(lineCurrent, styler)) &&
-				(!IsQuoteLine(lineCurrent, styler)))
+		LineClass lineClass = ClassifyLine(lineCurrent, styler);
+		if (lineClass.lineSignificant != lineCurrent) {
+			// Jump over a run of lines already known to be blank, comment, or quote
+			lineCurrent = lineClass.lineSignificant;
+			lineClass = ClassifyLine(lineCurrent, styler);
+		}
+		indentCurrent = lineClass.indent;
+		if (lineClass.Significant())
 			break;
 	}
 	int indentCurrentLevel = indentCurrent & SC_FOLDLEVELNUMBERMASK;
@@ -940,7 +1017,7 @@ void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, i
 		int quote = false;
 		if (lineNext <= docLines) {
 			// Information about next line is only available if not at end of document
-			indentNext = styler.IndentAmount(lineNext, &spaceFlags, nullptr);
+			indentNext = ClassifyLine(lineNext, styler).indent;
 			const Sci_Position lookAtPos = (styler.LineStart(lineNext) == styler.Length()) ? styler.Length() - 1 : styler.LineStart(lineNext);
 			const int style = styler.StyleAt(lookAtPos) & 31;
 			quote = options.foldQuotes && IsPyTripleQuoteStringState(style);
@@ -971,14 +1048,14 @@ void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, i
 		int minCommentLevel = indentCurrentLevel;
 		while (!quote &&
 				(lineNext < docLines) &&
-				((indentNext & SC_FOLDLEVELWHITEFLAG) || (IsCommentLine(lineNext, styler)))) {
+				((indentNext & SC_FOLDLEVELWHITEFLAG) || (ClassifyLine(lineNext, styler).comment))) {
 
-			if (IsCommentLine(lineNext, styler) && indentNext < minCommentLevel) {
+			if (ClassifyLine(lineNext, styler).comment && indentNext < minCommentLevel) {
 				minCommentLevel = indentNext;
 			}
 
 			lineNext++;
-			indentNext = styler.IndentAmount(lineNext, &spaceFlags, nullptr);
+			indentNext = ClassifyLine(lineNext, styler).indent;
 		}
 
 		const int levelAfterComments = ((lineNext < docLines) ? indentNext & SC_FOLDLEVELNUMBERMASK : minCommentLevel);
@@ -993,7 +1070,8 @@ void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, i
 		int skipLevel = levelAfterComments;
 
 		while (--skipLine > lineCurrent) {
-			const int skipLineIndent = styler.IndentAmount(skipLine, &spaceFlags, nullptr);
+			const LineClass skipLineClass = ClassifyLine(skipLine, styler);
+			const int skipLineIndent = skipLineClass.indent;
 
 			if (options.foldCompact) {
 				if ((skipLineIndent & SC_FOLDLEVELNUMBERMASK) > levelAfterComments)
@@ -1005,7 +1083,7 @@ void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, i
 			} else {
 				if ((skipLineIndent & SC_FOLDLEVELNUMBERMASK) > levelAfterComments &&
 						!(skipLineIndent & SC_FOLDLEVELWHITEFLAG) &&
-						!IsCommentLine(skipLine, styler))
+						!skipLineClass.comment)
 					skipLevel = levelBeforeComments;
 
 				styler.SetLevel(skipLine, skipLevel);
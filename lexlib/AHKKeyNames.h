@@ -0,0 +1,157 @@
+// Scintilla source code edit control
+/** @file AHKKeyNames.h
+ ** Recognise AutoHotkey key and mouse button names.
+ ** The names are compiled into a case-insensitive automaton when the lexer is built
+ ** so that checking a word costs one table lookup per character.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef AHKKEYNAMES_H
+#define AHKKEYNAMES_H
+
+namespace Lexilla {
+
+// Names understood by AutoHotkey's TextToVK() and TextToSC().
+// See keyboard_mouse.cpp g_key_to_vk and g_key_to_sc for more details.
+constexpr std::string_view ahkKeyNames[] = {
+	// Numpad with NumLock on
+	"numpad0", "numpad1", "numpad2", "numpad3", "numpad4",
+	"numpad5", "numpad6", "numpad7", "numpad8", "numpad9",
+	"numpadmult", "numpaddiv", "numpadadd", "numpadsub", "numpaddot", "numpadenter",
+	// Numpad with NumLock off
+	"numpaddel", "numpadins", "numpadclear", "numpadup", "numpaddown", "numpadleft",
+	"numpadright", "numpadhome", "numpadend", "numpadpgup", "numpadpgdn",
+	// Lock keys
+	"numlock", "scrolllock", "capslock",
+	// General keys
+	"escape", "esc", "tab", "space", "backspace", "bs", "enter",
+	"delete", "del", "insert", "ins", "home", "end", "pgup", "pgdn",
+	"up", "down", "left", "right",
+	"printscreen", "ctrlbreak", "pause", "help", "sleep", "appskey",
+	// Modifiers
+	"lwin", "rwin", "control", "ctrl", "alt", "shift",
+	"lcontrol", "lctrl", "rcontrol", "rctrl", "lshift", "rshift", "lalt", "ralt",
+	// Function keys
+	"f1", "f2", "f3", "f4", "f5", "f6", "f7", "f8", "f9", "f10", "f11", "f12",
+	"f13", "f14", "f15", "f16", "f17", "f18", "f19", "f20", "f21", "f22", "f23", "f24",
+	// Mouse buttons and wheel
+	"lbutton", "rbutton", "mbutton", "xbutton1", "xbutton2",
+	"wheeldown", "wheelup", "wheelleft", "wheelright",
+	// Multimedia keys
+	"browser_back", "browser_forward", "browser_refresh", "browser_stop",
+	"browser_search", "browser_favorites", "browser_home",
+	"volume_mute", "volume_down", "volume_up",
+	"media_next", "media_prev", "media_stop", "media_play_pause",
+	"launch_mail", "launch_media", "launch_app1", "launch_app2",
+};
+
+namespace AHKKeys {
+
+// Characters that may appear in a key name are mapped to a compact alphabet
+// with letters folded to lower case; everything else rejects the word.
+constexpr int symbols = 10 + 26 + 1;
+
+constexpr int Symbol(int ch) noexcept {
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'a' && ch <= 'z')
+		return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'Z')
+		return ch - 'A' + 10;
+	if (ch == '_')
+		return 36;
+	return -1;
+}
+
+constexpr bool IsHexSymbol(int symbol) noexcept {
+	return symbol < 16;
+}
+
+// State 0 rejects and has no way out, state 1 is the start state.
+template <size_t capacity>
+struct Automaton {
+	unsigned short next[capacity][symbols] {};
+	bool accept[capacity] {};
+	size_t states = 2;
+
+	constexpr size_t Transition(size_t state, int symbol) {
+		if (!next[state][symbol]) {
+			next[state][symbol] = static_cast<unsigned short>(states++);
+		}
+		return next[state][symbol];
+	}
+
+	constexpr size_t AddWord(std::string_view word) {
+		size_t state = 1;
+		for (const char ch : word) {
+			state = Transition(state, Symbol(ch));
+		}
+		accept[state] = true;
+		return state;
+	}
+
+	constexpr size_t AddHexDigits(size_t state) {
+		// One or more hex digits, looping on the accepting state
+		const size_t hex = states++;
+		accept[hex] = true;
+		for (int symbol = 0; IsHexSymbol(symbol); symbol++) {
+			next[state][symbol] = static_cast<unsigned short>(hex);
+			next[hex][symbol] = static_cast<unsigned short>(hex);
+		}
+		return hex;
+	}
+};
+
+template <size_t capacity>
+constexpr Automaton<capacity> Build() {
+	Automaton<capacity> automaton;
+	for (const std::string_view &name : ahkKeyNames) {
+		automaton.AddWord(name);
+	}
+	// scNNN
+	const size_t sc = automaton.AddHexDigits(automaton.Transition(automaton.Transition(1, Symbol('s')), Symbol('c')));
+	// vkNN optionally followed by scNNN
+	const size_t vk = automaton.AddHexDigits(automaton.Transition(automaton.Transition(1, Symbol('v')), Symbol('k')));
+	const size_t vks = automaton.Transition(automaton.Transition(vk, Symbol('s')), Symbol('c'));
+	for (int symbol = 0; IsHexSymbol(symbol); symbol++) {
+		automaton.next[vks][symbol] = static_cast<unsigned short>(sc);
+	}
+	return automaton;
+}
+
+constexpr size_t Capacity() noexcept {
+	size_t characters = 0;
+	for (const std::string_view &name : ahkKeyNames) {
+		characters += name.length();
+	}
+	// Start, reject and the vkNN/scNNN states
+	return characters + 2 + 6;
+}
+
+constexpr size_t States() {
+	return Build<Capacity()>().states;
+}
+
+inline constexpr Automaton<States()> keyNames = Build<States()>();
+
+}
+
+/** Is @a word the name of a key or mouse button, including the vkNN and scNNN forms?
+ * Single characters are not names: callers decide whether those are keys.
+ */
+constexpr bool IsAHKKeyName(std::string_view word) noexcept {
+	size_t state = 1;
+	for (const char ch : word) {
+		const int symbol = AHKKeys::Symbol(static_cast<unsigned char>(ch));
+		if (symbol < 0)
+			return false;
+		state = AHKKeys::keyNames.next[state][symbol];
+		if (!state)
+			return false;
+	}
+	return AHKKeys::keyNames.accept[state];
+}
+
+}
+
+#endif
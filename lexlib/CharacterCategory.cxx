@@ -3913,11 +3913,12 @@ constexpr int maskCategory = 0x1F;
 // Initial version has 3249 entries and adds about 13K to the executable.
 // The array is in ascending order so can be searched using binary search.
 // Therefore the average call takes log2(3249) = 12 comparisons.
-// For speed, it may be useful to make a linear table for the common values,
-// possibly for 0..0xff for most Western European text or 0..0xfff for most
-// alphabetic languages.
+// For speed, characters in the Basic Multilingual Plane are looked up in a
+// linear table built on first use, see CharacterClasses below.
 
-CharacterCategory CategoriseCharacter(int character) {
+namespace {
+
+CharacterCategory CategoryFromRanges(int character) noexcept {
 	if (character < 0 || character > maxUnicode)
 		return ccCn;
 	const int baseValue = character * (maskCategory+1) + maskCategory;
@@ -3925,6 +3926,8 @@ CharacterCategory CategoriseCharacter(int character) {
 	return static_cast<CharacterCategory>(*(placeAfter-1) & maskCategory);
 }
 
+}
+
 // Implementation of character sets recommended for identifiers in Unicode Standard Annex #31.
 // http://unicode.org/reports/tr31/
 
@@ -4021,11 +4024,9 @@ bool OmitXidContinue(int character) noexcept {
 	}
 }
 
-}
-
 // UAX #31 defines ID_Start as
 // [[:L:][:Nl:][:Other_ID_Start:]--[:Pattern_Syntax:]--[:Pattern_White_Space:]]
-bool IsIdStart(int character) {
+bool IdStartOfCategory(int character, CharacterCategory c) noexcept {
 	if (IsIdPattern(character)) {
 		return false;
 	}
@@ -4033,14 +4034,13 @@ bool IsIdStart(int character) {
 	if (oid == OtherID::oidStart) {
 		return true;
 	}
-	const CharacterCategory c = CategoriseCharacter(character);
 	return (c == ccLl || c == ccLu || c == ccLt || c == ccLm || c == ccLo
 		|| c == ccNl);
 }
 
 // UAX #31 defines ID_Continue as
 // [[:ID_Start:][:Mn:][:Mc:][:Nd:][:Pc:][:Other_ID_Continue:]--[:Pattern_Syntax:]--[:Pattern_White_Space:]]
-bool IsIdContinue(int character) {
+bool IdContinueOfCategory(int character, CharacterCategory c) noexcept {
 	if (IsIdPattern(character)) {
 		return false;
 	}
@@ -4048,13 +4048,99 @@ bool IsIdContinue(int character) {
 	if (oid != OtherID::oidNone) {
 		return true;
 	}
-	const CharacterCategory c = CategoriseCharacter(character);
 	return (c == ccLl || c == ccLu || c == ccLt || c == ccLm || c == ccLo
 		|| c == ccNl || c == ccMn || c == ccMc || c == ccNd || c == ccPc);
 }
 
+// Each character in the Basic Multilingual Plane has a byte holding its category
+// in the low 5 bits and whether it is in ID_Start, ID_Continue, XID_Start, and
+// XID_Continue in the high bits so lexers checking identifiers in scripts like
+// Greek or CJK avoid the binary search through catRanges.
+// The table takes 64K and is built from catRanges on first use.
+constexpr int maxTabled = 0xFFFF;
+constexpr unsigned char classIdStart = 0x20;
+constexpr unsigned char classIdContinue = 0x40;
+// Set when XID differs from ID for this character so the slow path is taken.
+constexpr unsigned char classXidOmitted = 0x80;
+
+// Expand catRanges into the category of each of the first size characters.
+void ExpandRanges(std::vector<unsigned char> &dense, int size) {
+	dense.resize(size);
+
+	int end = 0;
+	int index = 0;
+	int current = catRanges[index];
+	++index;
+	do {
+		const int next = catRanges[index];
+		const unsigned char category = current & maskCategory;
+		current >>= 5;
+		end = std::min(size, next >> 5);
+		while (current < end) {
+			dense[current++] = category;
+		}
+		current = next;
+		++index;
+	} while (size > end);
+}
+
+class CharacterClasses {
+	std::vector<unsigned char> classes;
+public:
+	CharacterClasses() {
+		ExpandRanges(classes, maxTabled + 1);
+		for (int character = 0; character <= maxTabled; character++) {
+			const CharacterCategory category = static_cast<CharacterCategory>(classes[character]);
+			if (IdStartOfCategory(character, category))
+				classes[character] |= classIdStart;
+			if (IdContinueOfCategory(character, category))
+				classes[character] |= classIdContinue;
+			if (OmitXidStart(character) || OmitXidContinue(character))
+				classes[character] |= classXidOmitted;
+		}
+	}
+	unsigned char Of(int character) const noexcept {
+		return classes[character];
+	}
+};
+
+const CharacterClasses &Classes() {
+	// Built once, in a thread-safe way, when first needed
+	static const CharacterClasses classes;
+	return classes;
+}
+
+constexpr bool IsTabled(int character) noexcept {
+	return (character >= 0) && (character <= maxTabled);
+}
+
+}
+
+CharacterCategory CategoriseCharacter(int character) {
+	if (IsTabled(character))
+		return static_cast<CharacterCategory>(Classes().Of(character) & maskCategory);
+	return CategoryFromRanges(character);
+}
+
+bool IsIdStart(int character) {
+	if (IsTabled(character))
+		return (Classes().Of(character) & classIdStart) != 0;
+	return IdStartOfCategory(character, CategoryFromRanges(character));
+}
+
+bool IsIdContinue(int character) {
+	if (IsTabled(character))
+		return (Classes().Of(character) & classIdContinue) != 0;
+	return IdContinueOfCategory(character, CategoryFromRanges(character));
+}
+
 // XID_Start is ID_Start modified for Normalization Form KC in UAX #31
 bool IsXidStart(int character) {
+	if (IsTabled(character)) {
+		const unsigned char value = Classes().Of(character);
+		if (!(value & classXidOmitted))
+			return (value & classIdStart) != 0;
+	}
 	if (OmitXidStart(character)) {
 		return false;
 	} else {
@@ -4064,6 +4150,11 @@ bool IsXidStart(int character) {
 
 // XID_Continue is ID_Continue modified for Normalization Form KC in UAX #31
 bool IsXidContinue(int character) {
+	if (IsTabled(character)) {
+		const unsigned char value = Classes().Of(character);
+		if (!(value & classXidOmitted))
+			return (value & classIdContinue) != 0;
+	}
 	if (OmitXidContinue(character)) {
 		return false;
 	} else {
@@ -4081,23 +4172,7 @@ int CharacterCategoryMap::Size() const noexcept {
 
 void CharacterCategoryMap::Optimize(int countCharacters) {
 	const int characters = std::clamp(countCharacters, 256, maxUnicode + 1);
-	dense.resize(characters);
-
-	int end = 0;
-	int index = 0;
-	int current = catRanges[index];
-	++index;
-	do {
-		const int next = catRanges[index];
-		const unsigned char category = current & maskCategory;
-		current >>= 5;
-		end = std::min(characters, next >> 5);
-		while (current < end) {
-			dense[current++] = category;
-		}
-		current = next;
-		++index;
-	} while (characters > end);
+	ExpandRanges(dense, characters);
 }
 
 }
@@ -12,6 +12,8 @@
 
 #include "ILexer.h"
 
+#include "IDocumentStyles.h"
+
 #include "LexAccessor.h"
 #include "CharacterSet.h"
 
@@ -19,6 +21,29 @@ using namespace Lexilla;
 
 namespace Lexilla {
 
+LexAccessor::~LexAccessor() {
+	delete []styleReadBuf;
+}
+
+bool LexAccessor::StyleRangeAvailable() const noexcept {
+	return documentVersion == dvStyleRange;
+}
+
+char LexAccessor::StyleAtFill(Sci_Position position) const {
+	if (!styleRange || position < 0 || position >= lenDoc) {
+		return pAccess->StyleAt(position);
+	}
+	if (!styleReadBuf) {
+		// Only allocated once styles are read so lexers that do not read styles pay nothing
+		styleReadBuf = new char[bufferSize];
+	}
+	// Styles are mostly read forwards so place the window like the character buffer
+	styleReadStart = std::max<Sci_Position>(std::min<Sci_Position>(position - slopSize, lenDoc - bufferSize), 0);
+	styleReadEnd = std::min<Sci_Position>(styleReadStart + bufferSize, lenDoc);
+	static_cast<const IDocumentStyles *>(pAccess)->GetStyleRange(styleReadBuf, styleReadStart, styleReadEnd - styleReadStart);
+	return styleReadBuf[position - styleReadStart];
+}
+
 bool LexAccessor::MatchIgnoreCase(Sci_Position pos, const char *s) {
 	assert(s);
 	for (; *s; s++, pos++) {
@@ -32,6 +32,11 @@ private:
 	Sci_PositionU startSeg;
 	Sci_Position startPosStyling;
 	int documentVersion;
+	// Window of styles read from documents that implement IDocumentStyles
+	bool styleRange;
+	mutable Sci_Position styleReadStart;
+	mutable Sci_Position styleReadEnd;
+	mutable char *styleReadBuf;
 
 	void Fill(Sci_Position position) {
 		startPos = position - slopSize;
@@ -46,6 +51,12 @@ private:
 		pAccess->GetCharRange(buf, startPos, endPos-startPos);
 		buf[endPos-startPos] = '\0';
 	}
+	bool StyleRangeAvailable() const noexcept;
+	char StyleAtFill(Sci_Position position) const;
+	void InvalidateStyleRead() noexcept {
+		styleReadStart = extremePosition;
+		styleReadEnd = 0;
+	}
 
 public:
 	explicit LexAccessor(Scintilla::IDocument *pAccess_) :
@@ -55,7 +66,10 @@ public:
 		lenDoc(pAccess->Length()),
 		validLen(0),
 		startSeg(0), startPosStyling(0),
-		documentVersion(pAccess->Version()) {
+		documentVersion(pAccess->Version()),
+		styleRange(StyleRangeAvailable()),
+		styleReadStart(extremePosition), styleReadEnd(0),
+		styleReadBuf(nullptr) {
 		// Prevent warnings by static analyzers about uninitialized buf and styleBuf.
 		buf[0] = 0;
 		styleBuf[0] = 0;
@@ -74,6 +88,12 @@ public:
 			break;
 		}
 	}
+	// Deleted so LexAccessor objects can not be copied.
+	LexAccessor(const LexAccessor &) = delete;
+	LexAccessor(LexAccessor &&) = delete;
+	LexAccessor &operator=(const LexAccessor &) = delete;
+	LexAccessor &operator=(LexAccessor &&) = delete;
+	~LexAccessor();
 	char operator[](Sci_Position position) {
 		if (position < startPos || position >= endPos) {
 			Fill(position);
@@ -94,6 +114,17 @@ public:
 		}
 		return buf[position - startPos];
 	}
+	/** Pointer into the buffer for reading length bytes from position without further checks.
+	 * Returns nullptr when fewer than length bytes remain in the document. */
+	const char *BufferPointer(Sci_Position position, Sci_Position length) {
+		if (position < startPos || position + length > endPos) {
+			Fill(position);
+			if (position < startPos || position + length > endPos) {
+				return nullptr;
+			}
+		}
+		return buf + position - startPos;
+	}
 	bool IsLeadByte(char ch) const {
 		return
 			(static_cast<unsigned char>(ch) >= 0x80) &&	// non-ASCII
@@ -122,10 +153,13 @@ public:
 	std::string GetRangeLowered(Sci_PositionU startPos_, Sci_PositionU endPos_);
 
 	char StyleAt(Sci_Position position) const {
-		return pAccess->StyleAt(position);
+		if (position >= styleReadStart && position < styleReadEnd) {
+			return styleReadBuf[position - styleReadStart];
+		}
+		return StyleAtFill(position);
 	}
 	int StyleIndexAt(Sci_Position position) const {
-		return static_cast<unsigned char>(pAccess->StyleAt(position));
+		return static_cast<unsigned char>(StyleAt(position));
 	}
 	// Return style value from buffer when in buffer, else retrieve from document.
 	// This is faster and can avoid calls to Flush() as that may be expensive.
@@ -134,7 +168,7 @@ public:
 		if (index >= 0 && index < validLen) {
 			return static_cast<unsigned char>(styleBuf[index]);
 		}
-		return static_cast<unsigned char>(pAccess->StyleAt(position));
+		return static_cast<unsigned char>(StyleAt(position));
 	}
 	Sci_Position GetLine(Sci_Position position) const {
 		return pAccess->LineFromPosition(position);
@@ -156,6 +190,7 @@ public:
 			pAccess->SetStyles(validLen, styleBuf);
 			startPosStyling += validLen;
 			validLen = 0;
+			InvalidateStyleRead();
 		}
 	}
 	int GetLineState(Sci_Position line) const {
@@ -168,6 +203,7 @@ public:
 	void StartAt(Sci_PositionU start) {
 		pAccess->StartStyling(start);
 		startPosStyling = start;
+		InvalidateStyleRead();
 	}
 	Sci_PositionU GetStartSegment() const {
 		return startSeg;
@@ -189,6 +225,7 @@ public:
 			if (validLen + (pos - startSeg + 1) >= bufferSize) {
 				// Too big for buffer so send directly
 				pAccess->SetStyleFor(pos - startSeg + 1, attr);
+				InvalidateStyleRead();
 			} else {
 				for (Sci_PositionU i = startSeg; i <= pos; i++) {
 					assert((startPosStyling + validLen) < Length());
@@ -0,0 +1,23 @@
+// Scintilla source code edit control
+/** @file LexerClone.h
+ ** Operation for lexers that can create new instances sharing their configuration.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef LEXERCLONE_H
+#define LEXERCLONE_H
+
+namespace Lexilla {
+
+// A lexer that has been configured with properties, word lists, and substyles can be
+// used as a prototype: each clone shares the configuration until it is changed
+// and owns only the state derived from its document.
+// Lexers opt in by returning a new ILexer5 from PrivateCall(privateCallClone, nullptr)
+// so CloneLexer works through the ILexer5 interface without RTTI. Lexers that do not
+// support cloning return nullptr as for any unknown operation.
+// The value is unusual so it is unlikely to mean something else to other lexers.
+constexpr int privateCallClone = 0x4C58434C;
+
+}
+
+#endif
@@ -0,0 +1,185 @@
+// Scintilla source code edit control
+/** @file LineCheckpoints.h
+ ** Record lexer states inside long lines so lexing can resume near a change
+ ** instead of at the start of the line.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef LINECHECKPOINTS_H
+#define LINECHECKPOINTS_H
+
+namespace Lexilla {
+
+// Applications restyle from the start of the line containing a change so a document
+// that is a single long line, such as minified script or data, is lexed again from
+// its start after every edit.
+// When lexing starts on a long line, the lexer may add a checkpoint of its complete
+// state at a token boundary every spacing bytes. Each checkpoint holds hashes of the
+// text and of the styles since the previous checkpoint so, when lexing starts again at
+// the same position in the same state, it can resume from the last checkpoint whose
+// preceding text is unchanged and whose preceding styles are still those it set.
+// Styles may be cleared or changed without any change to the text, such as by
+// SCI_CLEARDOCUMENTSTYLE, so the text alone does not show that they can be kept.
+// The styles are hashed by Styled once the lexer has flushed them to the document.
+// Lexers are not told where a change was made so Resume reads and hashes all the text
+// and styles from the start of the line up to the first changed checkpoint: the cost of an edit
+// is still linear in its distance from the start of the line. Hashing is much cheaper
+// than lexing, about 100 times faster for JSON, so the time is dominated by lexing from
+// the checkpoint.
+// The state type T must be copyable and comparable with ==.
+template <typename T>
+class LineCheckpoints {
+public:
+	// Decisions made before a checkpoint may depend on this much text after it
+	static constexpr Sci_PositionU lookAhead = 1024;
+private:
+	struct Checkpoint {
+		Sci_PositionU position;
+		// Hash of the text from the previous checkpoint until lookAhead after position
+		std::uint64_t hash;
+		// Hash of the styles from the previous checkpoint until position
+		std::uint64_t hashStyles;
+		T state;
+	};
+	struct Line {
+		Sci_PositionU start;
+		Sci_PositionU end;
+		// State at start
+		T state;
+		std::vector<Checkpoint> checkpoints;
+		// Number of checkpoints with hashStyles set
+		size_t styled = 0;
+		Sci_PositionU Last() const noexcept {
+			return checkpoints.empty() ? start : checkpoints.back().position;
+		}
+	};
+	static constexpr Sci_PositionU blockSize = 4096;
+	Sci_PositionU spacing;
+	// Ordered by start
+	std::vector<Line> lines;
+	// Index of the line receiving checkpoints or lines.size() when none
+	size_t current = 0;
+
+	typename std::vector<Line>::iterator Find(Sci_PositionU position) {
+		return std::lower_bound(lines.begin(), lines.end(), position,
+			[](const Line &line, Sci_PositionU pos) noexcept { return line.start < pos; });
+	}
+	static constexpr std::uint64_t Mix(std::uint64_t hash, std::uint64_t value) noexcept {
+		return (((hash << 5) | (hash >> 59)) ^ value) * 0x517CC1B727220A95ULL;
+	}
+	static std::uint64_t HashText(LexAccessor &styler, Sci_PositionU start, Sci_PositionU position) {
+		const Sci_PositionU end = std::min<Sci_PositionU>(position + lookAhead, styler.Length());
+		std::uint64_t hash = end - start;
+		char block[blockSize + 1];
+		for (Sci_PositionU pos = start; pos < end; pos += blockSize) {
+			const Sci_PositionU lengthBlock = std::min(end - pos, blockSize);
+			styler.GetRange(pos, pos + lengthBlock, block, lengthBlock + 1);
+			Sci_PositionU i = 0;
+			for (; i + sizeof(std::uint64_t) <= lengthBlock; i += sizeof(std::uint64_t)) {
+				std::uint64_t word;
+				memcpy(&word, block + i, sizeof(word));
+				hash = Mix(hash, word);
+			}
+			for (; i < lengthBlock; i++) {
+				hash = Mix(hash, static_cast<unsigned char>(block[i]));
+			}
+		}
+		return hash;
+	}
+	static std::uint64_t HashStyles(const LexAccessor &styler, Sci_PositionU start, Sci_PositionU position) {
+		std::uint64_t hash = position - start;
+		for (Sci_PositionU pos = start; pos < position; pos++) {
+			hash = Mix(hash, static_cast<unsigned char>(styler.StyleAt(pos)));
+		}
+		return hash;
+	}
+
+public:
+	explicit LineCheckpoints(Sci_PositionU spacing_=0x10000) noexcept : spacing(spacing_) {
+	}
+	// Forget all checkpoints, such as when a property or word list changes styling.
+	void Clear() noexcept {
+		lines.clear();
+		current = 0;
+	}
+	// Number of checkpoints over all lines
+	size_t size() const noexcept {
+		size_t total = 0;
+		for (const Line &line : lines) {
+			total += line.checkpoints.size();
+		}
+		return total;
+	}
+	// Call before lexing from startPos to endPos with state holding the state at startPos.
+	// Returns the position to lex from which is either startPos or a checkpoint
+	// whose state is then copied into state.
+	Sci_PositionU Resume(LexAccessor &styler, Sci_PositionU startPos, Sci_PositionU endPos, T &state) {
+		current = lines.size();
+		if (startPos >= endPos) {
+			return startPos;
+		}
+		// Checkpoints in the range are restyled so are dropped unless on the line starting there
+		auto it = Find(startPos);
+		const bool resumable = (it != lines.end()) && (it->start == startPos) && (it->state == state);
+		lines.erase(resumable ? it + 1 : it, Find(endPos));
+		const Sci_PositionU lineEnd = styler.LineEnd(styler.GetLine(startPos));
+		if (!resumable) {
+			if (lineEnd < startPos + spacing) {
+				// Too short to hold a checkpoint
+				return startPos;
+			}
+			it = lines.insert(it, Line{startPos, lineEnd, state, {}});
+			current = it - lines.begin();
+			return startPos;
+		}
+		current = it - lines.begin();
+		it->end = lineEnd;
+		std::vector<Checkpoint> &checkpoints = it->checkpoints;
+		size_t valid = 0;
+		Sci_PositionU previous = startPos;
+		while ((valid < it->styled) && (checkpoints[valid].position < endPos) &&
+			(HashText(styler, previous, checkpoints[valid].position) == checkpoints[valid].hash) &&
+			(HashStyles(styler, previous, checkpoints[valid].position) == checkpoints[valid].hashStyles)) {
+			previous = checkpoints[valid].position;
+			valid++;
+		}
+		checkpoints.erase(checkpoints.begin() + valid, checkpoints.end());
+		it->styled = valid;
+		if (checkpoints.empty()) {
+			return startPos;
+		}
+		state = checkpoints.back().state;
+		return checkpoints.back().position;
+	}
+	// Is a checkpoint wanted at position?
+	bool Due(Sci_PositionU position) const noexcept {
+		if (current >= lines.size()) {
+			return false;
+		}
+		const Line &line = lines[current];
+		return (position < line.end) && (position >= line.Last() + spacing);
+	}
+	// Record the state before the character at position is lexed.
+	void Add(LexAccessor &styler, Sci_PositionU position, const T &state) {
+		Line &line = lines[current];
+		const std::uint64_t hash = HashText(styler, line.Last(), position);
+		line.checkpoints.push_back({position, hash, 0, state});
+	}
+	// Call after lexing once styles are flushed to the document so the checkpoints
+	// added since Resume can be trusted by a later Resume.
+	void Styled(const LexAccessor &styler) {
+		if (current >= lines.size()) {
+			return;
+		}
+		Line &line = lines[current];
+		for (; line.styled < line.checkpoints.size(); line.styled++) {
+			Checkpoint &checkpoint = line.checkpoints[line.styled];
+			const Sci_PositionU previous = (line.styled > 0) ? line.checkpoints[line.styled - 1].position : line.start;
+			checkpoint.hashStyles = HashStyles(styler, previous, checkpoint.position);
+		}
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,248 @@
+// Scintilla source code edit control
+/** @file MacroDatabase.cxx
+ ** Read-only table of preprocessor definitions compiled ahead of time.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstdint>
+#include <cstring>
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#if !_WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <windows.h>
+#endif
+
+#include "MacroDatabase.h"
+
+using namespace Lexilla;
+
+namespace {
+
+constexpr std::string_view magic = "LXMACRO1";
+constexpr size_t headerLength = 8 + 4;
+// Offset and length for each of name, arguments, and value
+constexpr size_t fields = 3;
+constexpr size_t entryLength = fields * 2 * 4;
+
+uint32_t UInt32At(const unsigned char *p) noexcept {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+#if _WIN32
+
+std::wstring WideStringFromUTF8(std::string_view sv) {
+	const int sLength = static_cast<int>(sv.length());
+	const int cchWide = ::MultiByteToWideChar(CP_UTF8, 0, sv.data(), sLength, nullptr, 0);
+	std::wstring sWide(cchWide, 0);
+	::MultiByteToWideChar(CP_UTF8, 0, sv.data(), sLength, sWide.data(), cchWide);
+	return sWide;
+}
+
+bool FileIdentity(const char *path, int64_t &size, int64_t &time, int64_t &id) {
+	WIN32_FILE_ATTRIBUTE_DATA attributes {};
+	if (!::GetFileAttributesExW(WideStringFromUTF8(path).c_str(), GetFileExInfoStandard, &attributes))
+		return false;
+	size = (static_cast<int64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	time = (static_cast<int64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	id = 0;
+	return true;
+}
+
+// Windows will not replace a file while a view of it is mapped so read a private copy instead.
+void *MapFile(const char *path, size_t &length) {
+	void *mapping = nullptr;
+	const HANDLE file = ::CreateFileW(WideStringFromUTF8(path).c_str(), GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+	LARGE_INTEGER size {};
+	if (::GetFileSizeEx(file, &size) && (size.QuadPart > 0) && (size.QuadPart <= UINT32_MAX)) {
+		const DWORD sizeFile = static_cast<DWORD>(size.QuadPart);
+		mapping = ::VirtualAlloc(nullptr, sizeFile, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		DWORD sizeRead = 0;
+		if (mapping && ::ReadFile(file, mapping, sizeFile, &sizeRead, nullptr) && (sizeRead == sizeFile)) {
+			length = sizeFile;
+		} else if (mapping) {
+			::VirtualFree(mapping, 0, MEM_RELEASE);
+			mapping = nullptr;
+		}
+	}
+	::CloseHandle(file);
+	return mapping;
+}
+
+void UnmapFile(void *mapping, size_t) noexcept {
+	::VirtualFree(mapping, 0, MEM_RELEASE);
+}
+
+#else
+
+bool FileIdentity(const char *path, int64_t &size, int64_t &time, int64_t &id) {
+	struct stat st {};
+	if (::stat(path, &st) != 0)
+		return false;
+	size = st.st_size;
+	time = st.st_mtime;
+	// Replacing the file gives it a new inode even within the resolution of st_mtime
+	id = st.st_ino;
+	return true;
+}
+
+// The mapping stays valid when the file is replaced since it refers to the old inode.
+// Truncating or rewriting the file in place instead may fault on access so must be avoided.
+void *MapFile(const char *path, size_t &length) {
+	void *mapping = nullptr;
+	const int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+	struct stat st {};
+	if ((::fstat(fd, &st) == 0) && (st.st_size > 0)) {
+		void *view = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view != MAP_FAILED) {
+			mapping = view;
+			length = st.st_size;
+		}
+	}
+	::close(fd);
+	return mapping;
+}
+
+void UnmapFile(void *mapping, size_t length) noexcept {
+	::munmap(mapping, length);
+}
+
+#endif
+
+}
+
+MacroDatabase::~MacroDatabase() {
+	if (mapping) {
+		UnmapFile(mapping, mappingLength);
+	}
+}
+
+std::string_view MacroDatabase::Text(size_t entry, size_t field) const noexcept {
+	const unsigned char *p = data + headerLength + entry * entryLength + field * 8;
+	return std::string_view(reinterpret_cast<const char *>(data) + UInt32At(p), UInt32At(p + 4));
+}
+
+bool MacroDatabase::Validate() noexcept {
+	if ((length < headerLength) || (std::string_view(reinterpret_cast<const char *>(data), magic.length()) != magic))
+		return false;
+	count = UInt32At(data + magic.length());
+	if (count > (length - headerLength) / entryLength)
+		return false;
+	// All text within the data and names in order
+	std::string_view namePrevious;
+	fingerprint = 0;
+	for (size_t entry = 0; entry < count; entry++) {
+		for (size_t field = 0; field < fields; field++) {
+			const unsigned char *p = data + headerLength + entry * entryLength + field * 8;
+			const size_t offset = UInt32At(p);
+			if ((offset > length) || (UInt32At(p + 4) > length - offset))
+				return false;
+		}
+		const Definition definition = At(entry);
+		if (definition.name.empty() || ((entry > 0) && !(namePrevious < definition.name)))
+			return false;
+		namePrevious = definition.name;
+		fingerprint ^= HashDefinition(definition.name, definition.arguments, definition.value);
+	}
+	return true;
+}
+
+std::shared_ptr<const MacroDatabase> MacroDatabase::Open(const char *path) {
+	// Databases are shared while any user holds them
+	static std::mutex mutexDatabases;
+	static std::map<std::string, std::weak_ptr<const MacroDatabase>> databases;
+
+	int64_t fileSize = 0;
+	int64_t fileTime = 0;
+	int64_t fileId = 0;
+	if (!path || !*path || !FileIdentity(path, fileSize, fileTime, fileId))
+		return {};
+
+	std::lock_guard<std::mutex> guard(mutexDatabases);
+	std::weak_ptr<const MacroDatabase> &shared = databases[path];
+	std::shared_ptr<const MacroDatabase> existing = shared.lock();
+	if (existing && (existing->fileSize == fileSize) && (existing->fileTime == fileTime) && (existing->fileId == fileId))
+		return existing;
+
+	std::shared_ptr<MacroDatabase> database = std::make_shared<MacroDatabase>();
+	database->mapping = MapFile(path, database->mappingLength);
+	if (!database->mapping)
+		return {};
+	database->data = static_cast<const unsigned char *>(database->mapping);
+	database->length = database->mappingLength;
+	database->fileSize = fileSize;
+	database->fileTime = fileTime;
+	database->fileId = fileId;
+	if (!database->Validate())
+		return {};
+	shared = database;
+	return database;
+}
+
+std::shared_ptr<const MacroDatabase> MacroDatabase::FromMemory(std::string_view contents) {
+	std::shared_ptr<MacroDatabase> database = std::make_shared<MacroDatabase>();
+	database->data = reinterpret_cast<const unsigned char *>(contents.data());
+	database->length = contents.length();
+	if (!database->Validate())
+		return {};
+	return database;
+}
+
+uint64_t MacroDatabase::HashDefinition(std::string_view name, std::string_view arguments, std::string_view value) noexcept {
+	// FNV-1a over the name, arguments, and value, each followed by a separator
+	constexpr uint64_t prime = 0x100000001b3ULL;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (const std::string_view part : { name, arguments, value }) {
+		for (const char ch : part) {
+			hash = (hash ^ static_cast<unsigned char>(ch)) * prime;
+		}
+		hash *= prime;
+	}
+	return hash;
+}
+
+size_t MacroDatabase::Length() const noexcept {
+	return count;
+}
+
+MacroDatabase::Definition MacroDatabase::At(size_t index) const noexcept {
+	return { Text(index, 0), Text(index, 1), Text(index, 2) };
+}
+
+bool MacroDatabase::Find(std::string_view name, Definition &definition) const noexcept {
+	// Binary search over the sorted names
+	size_t low = 0;
+	size_t high = count;
+	while (low < high) {
+		const size_t middle = low + (high - low) / 2;
+		const std::string_view nameMiddle = Text(middle, 0);
+		if (nameMiddle < name) {
+			low = middle + 1;
+		} else if (name < nameMiddle) {
+			high = middle;
+		} else {
+			definition = At(middle);
+			return true;
+		}
+	}
+	return false;
+}
+
+uint64_t MacroDatabase::Fingerprint() const noexcept {
+	return fingerprint;
+}
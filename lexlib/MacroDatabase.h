@@ -0,0 +1,69 @@
+// Scintilla source code edit control
+/** @file MacroDatabase.h
+ ** Read-only table of preprocessor definitions compiled ahead of time.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef MACRODATABASE_H
+#define MACRODATABASE_H
+
+namespace Lexilla {
+
+/** Preprocessor definitions compiled into a file by scripts/MacroDatabase.py.
+ * The file is memory-mapped and shared by every user that opens the same path
+ * until it changes on disk. Open checks whether the file has changed each time it is called.
+ * Update the file by replacing it, as the script does, since rewriting it in place may
+ * invalidate a mapping still in use.
+ * Layout, with integers as unsigned 32-bit little-endian:
+ *   "LXMACRO1" count
+ *   count entries of offset and length for each of name, arguments, and value
+ *   text that the entries point into
+ * Entries are sorted by name. Arguments are empty for object-like macros.
+ */
+class MacroDatabase {
+public:
+	struct Definition {
+		std::string_view name;
+		std::string_view arguments;
+		std::string_view value;
+	};
+private:
+	const unsigned char *data = nullptr;
+	size_t length = 0;
+	size_t count = 0;
+	uint64_t fingerprint = 0;
+	void *mapping = nullptr;
+	size_t mappingLength = 0;
+	// Identifies the version of the file that was mapped
+	int64_t fileSize = 0;
+	int64_t fileTime = 0;
+	int64_t fileId = 0;
+
+	std::string_view Text(size_t entry, size_t field) const noexcept;
+	bool Validate() noexcept;
+public:
+	MacroDatabase() noexcept = default;
+	// Deleted so MacroDatabase objects can not be copied.
+	MacroDatabase(const MacroDatabase &) = delete;
+	MacroDatabase(MacroDatabase &&) = delete;
+	MacroDatabase &operator=(const MacroDatabase &) = delete;
+	MacroDatabase &operator=(MacroDatabase &&) = delete;
+	~MacroDatabase();
+
+	/// Returns the shared database for path or nullptr if it can not be read or is invalid.
+	static std::shared_ptr<const MacroDatabase> Open(const char *path);
+	/// Use a database already in memory which must outlive the result.
+	static std::shared_ptr<const MacroDatabase> FromMemory(std::string_view contents);
+
+	/// Hash of a definition. The fingerprint combines these for every definition with XOR.
+	static uint64_t HashDefinition(std::string_view name, std::string_view arguments, std::string_view value) noexcept;
+
+	size_t Length() const noexcept;
+	Definition At(size_t index) const noexcept;
+	bool Find(std::string_view name, Definition &definition) const noexcept;
+	uint64_t Fingerprint() const noexcept;
+};
+
+}
+
+#endif
@@ -7,6 +7,7 @@
 
 #include <cstdlib>
 #include <cstdint>
+#include <cstring>
 #include <cassert>
 
 #include <string>
@@ -18,9 +19,25 @@
 #include "Accessor.h"
 #include "StyleContext.h"
 #include "CharacterSet.h"
+#include "UTF8Decode.h"
 
 using namespace Lexilla;
 
+namespace {
+
+// Checks a block of bytes at once as two 64-bit words.
+constexpr int asciiBlock = 16;
+
+bool AllASCII(const char *s) noexcept {
+	uint64_t first = 0;
+	uint64_t second = 0;
+	memcpy(&first, s, sizeof(first));
+	memcpy(&second, s + sizeof(first), sizeof(second));
+	return ((first | second) & 0x8080808080808080ULL) == 0;
+}
+
+}
+
 StyleContext::StyleContext(Sci_PositionU startPos, Sci_PositionU length,
 	int initStyle, LexAccessor &styler_, char chMask) :
 	styler(styler_),
@@ -29,6 +46,7 @@ StyleContext::StyleContext(Sci_PositionU startPos, Sci_PositionU length,
 	endPos(((startPos + length) < lengthDocument) ? (startPos + length) : (lengthDocument+1)),
 	lineDocEnd(styler.GetLine(lengthDocument)),
 	currentPosLastRelative(SIZE_MAX),
+	decodeUTF8(styler.Encoding() == EncodingType::unicode),
 	currentPos(startPos),
 	currentLine(styler.GetLine(startPos)),
 	lineEnd(styler.LineEnd(currentLine)),
@@ -48,6 +66,73 @@ StyleContext::StyleContext(Sci_PositionU startPos, Sci_PositionU length,
 	GetNextChar();
 }
 
+void StyleContext::Decode(Sci_PositionU position) {
+	decodedIndex = 0;
+	decodedCount = 0;
+	decodedPosition = position;
+	while (decodedCount < decodeCapacity) {
+		if (decodedCount + asciiBlock <= decodeCapacity) {
+			const char *text = styler.BufferPointer(position, asciiBlock);
+			if (text && AllASCII(text)) {
+				for (int i = 0; i < asciiBlock; i++) {
+					decoded[decodedCount++] = { text[i], 1 };
+				}
+				position += asciiBlock;
+				continue;
+			}
+		}
+		Sci_Position widthCharacter = 1;
+		const int character = CharacterAndWidthUTF8(position, widthCharacter);
+		decoded[decodedCount++] = { character, static_cast<int>(widthCharacter) };
+		position += widthCharacter;
+	}
+}
+
+int StyleContext::CharacterAndWidthUTF8(Sci_PositionU position, Sci_Position &widthCharacter) {
+	widthCharacter = 1;
+	const Sci_Position pos = position;
+	const unsigned char leadByte = styler.SafeGetCharAt(pos, 0);
+	if (leadByte < 0x80) {
+		return leadByte;
+	}
+	const int widthCharBytes = UTF8BytesOfLead(leadByte);
+	unsigned char charBytes[4] = { leadByte, 0, 0, 0 };
+	for (int b = 1; b < widthCharBytes; b++) {
+		charBytes[b] = styler.SafeGetCharAt(pos + b, 0);
+	}
+	const int widthValid = UTF8ValidWidth(charBytes, widthCharBytes);
+	if (!widthValid) {
+		// Report as singleton surrogate values which are invalid Unicode
+		return 0xDC80 + leadByte;
+	}
+	widthCharacter = widthValid;
+	return UnicodeFromUTF8(charBytes, widthValid);
+}
+
+int StyleContext::RelativeCharacterUTF8(Sci_PositionU &position, Sci_Position characterOffset) {
+	// Walk forward decoding directly until reaching the decoded characters then use them
+	int index = decodedCount;
+	for (;;) {
+		if ((index >= decodedCount) && (position == decodedPosition)) {
+			index = decodedIndex;
+		}
+		Sci_Position widthCharacter = 1;
+		int character = 0;
+		if (index < decodedCount) {
+			character = decoded[index].character;
+			widthCharacter = decoded[index].width;
+			index++;
+		} else {
+			character = CharacterAndWidthUTF8(position, widthCharacter);
+		}
+		if (characterOffset == 0) {
+			return character;
+		}
+		position += widthCharacter;
+		characterOffset--;
+	}
+}
+
 bool StyleContext::MatchIgnoreCase(const char *s) {
 	if (MakeLowerCase(ch) != static_cast<unsigned char>(*s))
 		return false;
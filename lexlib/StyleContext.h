@@ -26,8 +26,38 @@ class StyleContext {
 	Sci_PositionU currentPosLastRelative;
 	Sci_Position offsetRelative = 0;
 
+	// UTF-8 is decoded ahead of the current position in batches from the LexAccessor
+	// buffer instead of calling IDocument::GetCharacterAndWidth for each character.
+	struct DecodedCharacter {
+		int character;
+		int width;
+	};
+	enum { decodeCapacity = 64 };
+	const bool decodeUTF8;
+	int decodedIndex = 0;
+	int decodedCount = 0;
+	// Position of decoded[decodedIndex]
+	Sci_PositionU decodedPosition = 0;
+	DecodedCharacter decoded[decodeCapacity];
+
+	void Decode(Sci_PositionU position);
+	int CharacterAndWidthUTF8(Sci_PositionU position, Sci_Position &widthCharacter);
+	int RelativeCharacterUTF8(Sci_PositionU &position, Sci_Position characterOffset);
+
+	int NextDecoded(Sci_PositionU position, Sci_Position &widthCharacter) {
+		if ((decodedIndex >= decodedCount) || (position != decodedPosition)) {
+			Decode(position);
+		}
+		const DecodedCharacter &dc = decoded[decodedIndex++];
+		decodedPosition += dc.width;
+		widthCharacter = dc.width;
+		return dc.character;
+	}
+
 	void GetNextChar() {
-		if (multiByteAccess) {
+		if (decodeUTF8) {
+			chNext = NextDecoded(currentPos+width, widthNext);
+		} else if (multiByteAccess) {
 			chNext = multiByteAccess->GetCharacterAndWidth(currentPos+width, &widthNext);
 		} else {
 			chNext = static_cast<unsigned char>(styler.SafeGetCharAt(currentPos+width, 0));
@@ -132,9 +162,14 @@ public:
 				offsetRelative = 0;
 			}
 			const Sci_Position diffRelative = n - offsetRelative;
-			const Sci_Position posNew = multiByteAccess->GetRelativePosition(posRelative, diffRelative);
-			const int chReturn = multiByteAccess->GetCharacterAndWidth(posNew, nullptr);
-			posRelative = posNew;
+			int chReturn = 0;
+			if (decodeUTF8 && (diffRelative >= 0)) {
+				chReturn = RelativeCharacterUTF8(posRelative, diffRelative);
+			} else {
+				const Sci_Position posNew = multiByteAccess->GetRelativePosition(posRelative, diffRelative);
+				chReturn = multiByteAccess->GetCharacterAndWidth(posNew, nullptr);
+				posRelative = posNew;
+			}
 			currentPosLastRelative = currentPos;
 			offsetRelative = n;
 			return chReturn;
@@ -0,0 +1,74 @@
+// Scintilla source code edit control
+/** @file UTF8Decode.h
+ ** Decode UTF-8 the way Scintilla does.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef UTF8DECODE_H
+#define UTF8DECODE_H
+
+namespace Lexilla {
+
+// Same classification of UTF-8 as Scintilla's Document::GetCharacterAndWidth so that
+// invalid bytes are reported the same way: singly, as surrogates 0xDC80 + byte.
+
+constexpr bool UTF8IsTrailByte(unsigned char ch) noexcept {
+	return (ch >= 0x80) && (ch < 0xc0);
+}
+
+constexpr int UTF8BytesOfLead(unsigned char ch) noexcept {
+	if (ch < 0xC2)
+		return 1;
+	if (ch < 0xE0)
+		return 2;
+	if (ch < 0xF0)
+		return 3;
+	if (ch < 0xF5)
+		return 4;
+	return 1;
+}
+
+// Width of a valid sequence or 0 when invalid.
+constexpr int UTF8ValidWidth(const unsigned char *us, int widthCharBytes) noexcept {
+	if (widthCharBytes == 1 || !UTF8IsTrailByte(us[1]))
+		return 0;
+	switch (widthCharBytes) {
+	case 2:
+		return 2;
+	case 3:
+		if (!UTF8IsTrailByte(us[2]))
+			return 0;
+		if ((us[0] == 0xe0) && ((us[1] & 0xe0) == 0x80))
+			return 0;	// Overlong
+		if ((us[0] == 0xed) && ((us[1] & 0xe0) == 0xa0))
+			return 0;	// Surrogate
+		if ((us[0] == 0xef) && (us[1] == 0xbf) && ((us[2] == 0xbe) || (us[2] == 0xbf)))
+			return 0;	// U+FFFE or U+FFFF
+		return 3;
+	default:
+		if (!UTF8IsTrailByte(us[2]) || !UTF8IsTrailByte(us[3]))
+			return 0;
+		if (((us[1] & 0xf) == 0xf) && (us[2] == 0xbf) && ((us[3] == 0xbe) || (us[3] == 0xbf)))
+			return 0;	// U+nFFFE or U+nFFFF
+		if ((us[0] == 0xf4) && ((us[1] & 0xf0) > 0x80))
+			return 0;	// Beyond U+10FFFF
+		if ((us[0] == 0xf0) && ((us[1] & 0xf0) == 0x80))
+			return 0;	// Overlong
+		return 4;
+	}
+}
+
+constexpr int UnicodeFromUTF8(const unsigned char *us, int widthCharBytes) noexcept {
+	switch (widthCharBytes) {
+	case 2:
+		return ((us[0] & 0x1F) << 6) + (us[1] & 0x3F);
+	case 3:
+		return ((us[0] & 0xF) << 12) + ((us[1] & 0x3F) << 6) + (us[2] & 0x3F);
+	default:
+		return ((us[0] & 0x7) << 18) + ((us[1] & 0x3F) << 12) + ((us[2] & 0x3F) << 6) + (us[3] & 0x3F);
+	}
+}
+
+}
+
+#endif
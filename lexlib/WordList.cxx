@@ -6,12 +6,15 @@
 // The License.txt file describes the conditions under which this software may be distributed.
 
 #include <cstdlib>
+#include <cstdint>
 #include <cassert>
 #include <cstring>
 
+#include <map>
 #include <algorithm>
 #include <iterator>
 #include <memory>
+#include <mutex>
 
 #include "WordList.h"
 
@@ -64,16 +67,172 @@ std::unique_ptr<char *[]> ArrayFromWordList(char *wordlist, size_t slen, size_t
 	return keywords;
 }
 
+constexpr bool IsSeparator(unsigned char ch, bool onlyLineEnds) noexcept {
+	return (ch == '\r') || (ch == '\n') || (!onlyLineEnds && ((ch == ' ') || (ch == '\t')));
+}
+
 bool cmpWords(const char *a, const char *b) noexcept {
 	return strcmp(a, b) < 0;
 }
 
+// FNV-1a over the text with all separators treated the same, also returning its length
+size_t HashText(const char *s, bool onlyLineEnds, size_t &length) noexcept {
+	constexpr uint64_t prime = 0x100000001b3ULL;
+	uint64_t hash = 0xcbf29ce484222325ULL ^ (onlyLineEnds ? 1 : 0);
+	size_t i = 0;
+	for (; s[i]; i++) {
+		const unsigned char ch = s[i];
+		hash = (hash ^ (IsSeparator(ch, onlyLineEnds) ? 0 : ch)) * prime;
+	}
+	length = i;
+	return static_cast<size_t>(hash);
+}
+
+}
+
+namespace Lexilla {
+
+// Sorted words set from a text. Immutable once created and only destroyed when the
+// last WordList using it releases it.
+struct SharedWordList {
+	// The text with each separator replaced by \0
+	std::unique_ptr<char[]> list;
+	size_t lenList = 0;
+	std::unique_ptr<char *[]> words;
+	size_t len = 0;
+	bool onlyLineEnds = false;
+	int starts[256] {};
+	size_t hash = 0;
+	// Protected by the cache mutex
+	int references = 0;
+
+	SharedWordList(const char *s, size_t lenS, bool onlyLineEnds_, size_t hash_) :
+		list(std::make_unique<char[]>(lenS + 1)), lenList(lenS), onlyLineEnds(onlyLineEnds_), hash(hash_) {
+		memcpy(list.get(), s, lenS + 1);
+		words = ArrayFromWordList(list.get(), lenS, &len, onlyLineEnds);
+		std::sort(words.get(), words.get() + len, cmpWords);
+		std::fill(starts, std::end(starts), -1);
+		for (int l = static_cast<int>(len - 1); l >= 0; l--) {
+			const unsigned char indexChar = words[l][0];
+			starts[indexChar] = l;
+		}
+	}
+
+	// Is s the same text that this was created from, allowing for different separators?
+	// s must be a string of length lenS.
+	bool SameText(const char *s) const noexcept {
+		for (size_t i = 0; i < lenList; i++) {
+			const char ch = s[i];
+			if (!ch)
+				return false;
+			if ((list[i] != ch) && (list[i] || !IsSeparator(ch, onlyLineEnds)))
+				return false;
+		}
+		return s[lenList] == '\0';
+	}
+};
+
+}
+
+namespace {
+
+// All the shared word lists in the process by hash of their text.
+class WordListCache {
+	std::mutex mutex;
+	std::multimap<size_t, SharedWordList *> lists;
+public:
+	// Return the list set from text s with an added reference, or nullptr if there is none.
+	SharedWordList *Find(const char *s, size_t lenS, bool onlyLineEnds, size_t hash) {
+		std::lock_guard<std::mutex> guard(mutex);
+		const auto range = lists.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it) {
+			SharedWordList *shared = it->second;
+			if ((shared->onlyLineEnds == onlyLineEnds) && (shared->lenList == lenS) && shared->SameText(s)) {
+				shared->references++;
+				return shared;
+			}
+		}
+		return nullptr;
+	}
+	// Add a new list, unless another thread added the same text first, and return the list
+	// to use with an added reference.
+	SharedWordList *Add(std::unique_ptr<SharedWordList> &&created) {
+		std::lock_guard<std::mutex> guard(mutex);
+		const auto range = lists.equal_range(created->hash);
+		for (auto it = range.first; it != range.second; ++it) {
+			SharedWordList *shared = it->second;
+			if ((shared->onlyLineEnds == created->onlyLineEnds) && (shared->lenList == created->lenList) &&
+				shared->SameText(created->list.get())) {
+				shared->references++;
+				return shared;
+			}
+		}
+		SharedWordList *shared = created.release();
+		shared->references = 1;
+		lists.emplace(shared->hash, shared);
+		return shared;
+	}
+	void AddReference(SharedWordList *shared) noexcept {
+		std::lock_guard<std::mutex> guard(mutex);
+		shared->references++;
+	}
+	void Release(SharedWordList *shared) noexcept {
+		std::lock_guard<std::mutex> guard(mutex);
+		shared->references--;
+		if (shared->references == 0) {
+			const auto range = lists.equal_range(shared->hash);
+			for (auto it = range.first; it != range.second; ++it) {
+				if (it->second == shared) {
+					lists.erase(it);
+					break;
+				}
+			}
+			delete shared;
+		}
+	}
+};
+
+// Never destroyed so it outlives any static WordList
+WordListCache &Cache() {
+	static WordListCache *cache = new WordListCache();
+	return *cache;
+}
+
+bool SameWords(const char *const *wordsA, size_t lenA, const char *const *wordsB, size_t lenB) noexcept {
+	if (lenA != lenB)
+		return false;
+	for (size_t i = 0; i < lenA; i++) {
+		if (strcmp(wordsA[i], wordsB[i]) != 0)
+			return false;
+	}
+	return true;
+}
+
 }
 
 WordList::WordList(bool onlyLineEnds_) noexcept :
-	words(nullptr), list(nullptr), len(0), onlyLineEnds(onlyLineEnds_) {
-	// Prevent warnings by static analyzers about uninitialized starts.
-	starts[0] = -1;
+	shared(nullptr), words(nullptr), len(0), onlyLineEnds(onlyLineEnds_), starts(nullptr) {
+}
+
+WordList::WordList(const WordList &other) noexcept :
+	shared(nullptr), words(nullptr), len(0), onlyLineEnds(other.onlyLineEnds), starts(nullptr) {
+	if (other.shared) {
+		Cache().AddReference(other.shared);
+		Attach(other.shared);
+	}
+}
+
+WordList &WordList::operator=(const WordList &other) noexcept {
+	if (this != &other) {
+		onlyLineEnds = other.onlyLineEnds;
+		if (other.shared) {
+			Cache().AddReference(other.shared);
+			Attach(other.shared);
+		} else {
+			Clear();
+		}
+	}
+	return *this;
 }
 
 WordList::~WordList() {
@@ -85,13 +244,7 @@ WordList::operator bool() const noexcept {
 }
 
 bool WordList::operator!=(const WordList &other) const noexcept {
-	if (len != other.len)
-		return true;
-	for (size_t i=0; i<len; i++) {
-		if (strcmp(words[i], other.words[i]) != 0)
-			return true;
-	}
-	return false;
+	return !SameWords(words, len, other.words, other.len);
 }
 
 int WordList::Length() const noexcept {
@@ -99,43 +252,55 @@ int WordList::Length() const noexcept {
 }
 
 void WordList::Clear() noexcept {
-	delete []list;
-	list = nullptr;
-	delete []words;
+	if (shared) {
+		Cache().Release(shared);
+	}
+	shared = nullptr;
 	words = nullptr;
 	len = 0;
+	starts = nullptr;
 }
 
+/** Is s the same text that the list was set from, allowing for different separators?
+ * The shared list keeps the text with each separator replaced by \0 so it can be compared
+ * in one pass without copying, splitting, or sorting s.
+ */
+bool WordList::SameText(const char *s) const noexcept {
+	return shared && shared->SameText(s);
+}
+
+void WordList::Attach(SharedWordList *shared_) noexcept {
+	Clear();
+	shared = shared_;
+	words = shared->words.get();
+	len = shared->len;
+	starts = shared->starts;
+}
+
+/** Set the list from a string of words separated by white space or line ends.
+ * Lists set from the same text share one copy of the sorted words.
+ * Returns whether the words in the list changed.
+ */
 bool WordList::Set(const char *s) {
-	const size_t lenS = strlen(s) + 1;
-	std::unique_ptr<char[]> listTemp = std::make_unique<char[]>(lenS);
-	memcpy(listTemp.get(), s, lenS);
-	size_t lenTemp = 0;
-	std::unique_ptr<char *[]> wordsTemp = ArrayFromWordList(listTemp.get(), lenS - 1, &lenTemp, onlyLineEnds);
-	std::sort(wordsTemp.get(), wordsTemp.get() + lenTemp, cmpWords);
-
-	if (lenTemp == len) {
-		bool changed = false;
-		for (size_t i = 0; i < lenTemp; i++) {
-			if (strcmp(words[i], wordsTemp[i]) != 0) {
-				changed = true;
-				break;
-			}
-		}
-		if (!changed) {
-			return false;
-		}
+	if (SameText(s)) {
+		return false;
 	}
 
-	Clear();
-	words = wordsTemp.release();
-	list = listTemp.release();
-	len = lenTemp;
-	std::fill(starts, std::end(starts), -1);
-	for (int l = static_cast<int>(len - 1); l >= 0; l--) {
-		unsigned char indexChar = words[l][0];
-		starts[indexChar] = l;
+	size_t lenS = 0;
+	const size_t hash = HashText(s, onlyLineEnds, lenS);
+	WordListCache &cache = Cache();
+	SharedWordList *found = cache.Find(s, lenS, onlyLineEnds, hash);
+	if (!found) {
+		found = cache.Add(std::make_unique<SharedWordList>(s, lenS, onlyLineEnds, hash));
 	}
+
+	if (SameWords(words, len, found->words.get(), found->len)) {
+		// Same words in a different order
+		cache.Release(found);
+		return false;
+	}
+
+	Attach(found);
 	return true;
 }
 
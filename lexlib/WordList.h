@@ -10,22 +10,26 @@
 
 namespace Lexilla {
 
+struct SharedWordList;
+
 /**
+ * The sorted words are held in a SharedWordList that is shared by all the
+ * WordList objects in the process that were set from the same text.
  */
 class WordList {
+	SharedWordList *shared;
 	// Each word contains at least one character - a empty word acts as sentinel at the end.
-	char **words;
-	char *list;
+	const char *const *words;
 	size_t len;
 	bool onlyLineEnds;	///< Delimited by any white space or only line ends
-	int starts[256];
+	const int *starts;
+	bool SameText(const char *s) const noexcept;
+	void Attach(SharedWordList *shared_) noexcept;
 public:
 	explicit WordList(bool onlyLineEnds_ = false) noexcept;
-	// Deleted so WordList objects can not be copied.
-	WordList(const WordList &) = delete;
-	WordList(WordList &&) = delete;
-	WordList &operator=(const WordList &) = delete;
-	WordList &operator=(WordList &&) = delete;
+	// Copies share the sorted words.
+	WordList(const WordList &other) noexcept;
+	WordList &operator=(const WordList &other) noexcept;
 	~WordList();
 	operator bool() const noexcept;
 	bool operator!=(const WordList &other) const noexcept;
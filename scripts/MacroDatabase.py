@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+# MacroDatabase.py - compile preprocessor definitions into a file for the cpp lexer's
+# lexer.cpp.macro.database property.
+# Requires Python 3.6 or later
+#
+# Usage: MacroDatabase.py output input...
+# Each input line is either a definition as written for keywords5 of the cpp lexer
+#     NAME  NAME=value  NAME(a,b)=value
+# or a #define as produced by "gcc -dM -E" or "clang -dM -E"
+#     #define NAME value
+# Later definitions of a name replace earlier ones.
+# The file layout is described in lexlib/MacroDatabase.h.
+
+import os, re, struct, sys
+
+defineRE = re.compile(r"#\s*define\s+([A-Za-z_$][\w$]*)(\([^)]*\))?\s*(.*)")
+
+def ParseLine(line):
+	line = line.strip()
+	if not line:
+		return None
+	if line.startswith("#"):
+		m = defineRE.match(line)
+		if not m:
+			return None
+		name, arguments, value = m.group(1), m.group(2) or "", m.group(3).strip()
+		if not arguments and not value:
+			value = "1"
+	else:
+		name, equals, value = line.partition("=")
+		if not equals:
+			value = "1"
+		arguments = ""
+		bracket = name.find("(")
+		if bracket >= 0:
+			arguments = name[bracket:]
+			name = name[:bracket]
+	# Stored without brackets to match the lexer
+	arguments = arguments.strip("()")
+	return name, arguments, value
+
+def Compile(lines):
+	definitions = {}
+	for line in lines:
+		definition = ParseLine(line)
+		if definition:
+			definitions[definition[0].encode("utf-8")] = [part.encode("utf-8") for part in definition]
+	names = sorted(definitions)
+	header = b"LXMACRO1" + struct.pack("<I", len(names))
+	entryLength = 3 * 2 * 4
+	offset = len(header) + len(names) * entryLength
+	entries = bytearray()
+	text = bytearray()
+	for name in names:
+		for part in definitions[name]:
+			entries += struct.pack("<II", offset + len(text), len(part))
+			text += part
+	return header + bytes(entries) + bytes(text)
+
+def main():
+	if len(sys.argv) < 3:
+		print("Usage: MacroDatabase.py output input...")
+		sys.exit(1)
+	lines = []
+	for path in sys.argv[2:]:
+		with open(path, encoding="utf-8", errors="replace") as f:
+			lines.extend(f.readlines())
+	# Replace the database rather than rewriting it in place as lexers may have it mapped
+	output = sys.argv[1]
+	temporary = output + ".tmp"
+	with open(temporary, "wb") as f:
+		f.write(Compile(lines))
+	os.replace(temporary, output)
+
+if __name__ == "__main__":
+	main()
@@ -23,6 +23,7 @@
 
 #include "LexerModule.h"
 #include "CatalogueModules.h"
+#include "LexerClone.h"
 
 using namespace Lexilla;
 
@@ -374,6 +375,15 @@ EXPORT_FUNCTION const char * CALLING_CONVENTION GetNameSpace() {
 	return "lexilla";
 }
 
+EXPORT_FUNCTION Scintilla::ILexer5 * CALLING_CONVENTION CloneLexer(Scintilla::ILexer5 *prototype) {
+	// Only lexers made by this library should be passed here as the operation
+	// may have another meaning to other lexers
+	if (prototype) {
+		return static_cast<Scintilla::ILexer5 *>(prototype->PrivateCall(privateCallClone, nullptr));
+	}
+	return nullptr;
+}
+
 // Not exported from binary as LexerModule must be built exactly the same as
 // modules listed above
 void AddStaticLexerModule(LexerModule *plm) {
@@ -4,7 +4,8 @@ $(DIR_O)/Lexilla.o: \
 	../../scintilla/include/ILexer.h \
 	../../scintilla/include/Sci_Position.h \
 	../lexlib/LexerModule.h \
-	../lexlib/CatalogueModules.h
+	../lexlib/CatalogueModules.h \
+	../lexlib/LexerClone.h
 $(DIR_O)/Accessor.o: \
 	../lexlib/Accessor.cxx \
 	../../scintilla/include/ILexer.h \
@@ -37,6 +38,7 @@ $(DIR_O)/LexAccessor.o: \
 	../lexlib/LexAccessor.cxx \
 	../../scintilla/include/ILexer.h \
 	../../scintilla/include/Sci_Position.h \
+	../include/IDocumentStyles.h \
 	../lexlib/LexAccessor.h \
 	../lexlib/CharacterSet.h
 $(DIR_O)/LexerBase.o: \
@@ -90,6 +92,9 @@ $(DIR_O)/LexerSimple.o: \
 	../lexlib/LexerModule.h \
 	../lexlib/LexerBase.h \
 	../lexlib/LexerSimple.h
+$(DIR_O)/MacroDatabase.o: \
+	../lexlib/MacroDatabase.cxx \
+	../lexlib/MacroDatabase.h
 $(DIR_O)/PropSetSimple.o: \
 	../lexlib/PropSetSimple.cxx \
 	../lexlib/PropSetSimple.h
@@ -100,7 +105,8 @@ $(DIR_O)/StyleContext.o: \
 	../lexlib/LexAccessor.h \
 	../lexlib/Accessor.h \
 	../lexlib/StyleContext.h \
-	../lexlib/CharacterSet.h
+	../lexlib/CharacterSet.h \
+	../lexlib/UTF8Decode.h
 $(DIR_O)/WordList.o: \
 	../lexlib/WordList.cxx \
 	../lexlib/WordList.h
@@ -146,14 +152,14 @@ $(DIR_O)/LexAHK1.o: \
 	../../scintilla/include/Sci_Position.h \
 	../../scintilla/include/Scintilla.h \
 	../include/SciLexer.h \
-	../lexlib/PropSetSimple.h \
 	../lexlib/WordList.h \
 	../lexlib/LexAccessor.h \
-	../lexlib/Accessor.h \
 	../lexlib/StyleContext.h \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
-	../lexlib/OptionSet.h
+	../lexlib/OptionSet.h \
+	../lexlib/DefaultLexer.h \
+	../lexlib/AHKKeyNames.h
 $(DIR_O)/LexAHK2.o: \
 	../lexers/LexAHK2.cxx \
 	../../scintilla/include/ILexer.h \
@@ -167,7 +173,8 @@ $(DIR_O)/LexAHK2.o: \
 	../lexlib/CharacterCategory.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/AHKKeyNames.h
 $(DIR_O)/LexAPDL.o: \
 	../lexers/LexAPDL.cxx \
 	../../scintilla/include/ILexer.h \
@@ -291,6 +298,7 @@ $(DIR_O)/LexBash.o: \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
+	../lexlib/SparseState.h \
 	../lexlib/SubStyles.h \
 	../lexlib/DefaultLexer.h
 $(DIR_O)/LexBasic.o: \
@@ -445,7 +453,10 @@ $(DIR_O)/LexCPP.o: \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
 	../lexlib/SparseState.h \
-	../lexlib/SubStyles.h
+	../lexlib/LineCheckpoints.h \
+	../lexlib/SubStyles.h \
+	../lexlib/MacroDatabase.h \
+	../lexlib/LexerClone.h
 $(DIR_O)/LexCrontab.o: \
 	../lexers/LexCrontab.cxx \
 	../../scintilla/include/ILexer.h \
@@ -758,6 +769,8 @@ $(DIR_O)/LexHTML.o: \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
+	../lexlib/SparseState.h \
+	../lexlib/LineCheckpoints.h \
 	../lexlib/DefaultLexer.h
 $(DIR_O)/LexIndent.o: \
 	../lexers/LexIndent.cxx \
@@ -795,6 +808,7 @@ $(DIR_O)/LexJSON.o: \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
+	../lexlib/LineCheckpoints.h \
 	../lexlib/DefaultLexer.h
 $(DIR_O)/LexJulia.o: \
 	../lexers/LexJulia.cxx \
@@ -1133,6 +1147,7 @@ $(DIR_O)/LexPerl.o: \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
+	../lexlib/SparseState.h \
 	../lexlib/DefaultLexer.h
 $(DIR_O)/LexPLM.o: \
 	../lexers/LexPLM.cxx \
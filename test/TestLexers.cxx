@@ -19,13 +19,16 @@
 #include <fstream>
 #include <iomanip>
 #include <filesystem>
+#include <chrono>
 
 #include "ILexer.h"
 
 #include "Lexilla.h"
+#include "IDocumentStyles.h"
 #include "LexillaAccess.h"
 
 #include "TestDocument.h"
+#include "HeadlessDocument.h"
 
 namespace {
 
@@ -533,12 +536,16 @@ public:
 
 };
 
-size_t FirstLineDifferent(std::string_view a, std::string_view b) {
+size_t FirstDifferent(std::string_view a, std::string_view b) {
 	size_t i = 0;
 	while (i < std::min(a.size(), b.size()) && a.at(i) == b.at(i)) {
 		i++;
 	}
-	return std::count(a.begin(), a.begin() + i, '\n');
+	return i;
+}
+
+size_t FirstLineDifferent(std::string_view a, std::string_view b) {
+	return std::count(a.begin(), a.begin() + FirstDifferent(a, b), '\n');
 }
 
 bool CheckSame(std::string_view augmentedText, std::string_view augmentedTextNew, std::string_view item, std::string_view suffix, const std::filesystem::path &path) {
@@ -778,6 +785,39 @@ void SetProperties(Scintilla::ILexer5 *plex, const PropertyMap &propertyMap, std
 	}
 }
 
+double MegabytesPerSecond(size_t bytes, std::chrono::steady_clock::duration duration) {
+	const double seconds = std::chrono::duration<double>(duration).count();
+	return (seconds > 0.0) ? (bytes / 1.0e6 / seconds) : 0.0;
+}
+
+void BenchmarkFile(const std::filesystem::path &path, std::string_view text, Scintilla::ILexer5 *plex, size_t size) {
+	assert(plex);
+	// Repeat the example, always starting copies on a new line, until reaching size bytes
+	std::string scaled;
+	scaled.reserve(size + text.length() + 1);
+	while (!text.empty() && scaled.length() < size) {
+		scaled.append(text);
+		if (text.back() != '\n') {
+			scaled.append("\n");
+		}
+	}
+
+	Lexilla::HeadlessDocument doc;
+	doc.Set(scaled);
+	Scintilla::IDocument *pdoc = &doc;
+
+	const auto startLex = std::chrono::steady_clock::now();
+	plex->Lex(0, pdoc->Length(), 0, pdoc);
+	const auto startFold = std::chrono::steady_clock::now();
+	plex->Fold(0, pdoc->Length(), 0, pdoc);
+	const auto endFold = std::chrono::steady_clock::now();
+
+	std::cout << "Benchmark " << path.string() << " " << scaled.length() << " bytes"
+		<< std::fixed << std::setprecision(1)
+		<< " lex " << MegabytesPerSecond(scaled.length(), startFold - startLex) << " MB/s"
+		<< " fold " << MegabytesPerSecond(scaled.length(), endFold - startFold) << " MB/s\n";
+	std::cout.unsetf(std::ios::floatfield);
+}
 
 bool TestFile(const std::filesystem::path &path, const PropertyMap &propertyMap) {
 	// Find and create correct lexer
@@ -833,6 +873,32 @@ bool TestFile(const std::filesystem::path &path, const PropertyMap &propertyMap)
 		success = false;
 	}
 
+	// The headless document used by applications should give the same results
+	if (success) {
+		Lexilla::HeadlessDocument docHeadless;
+		docHeadless.Set(text);
+		plex->Lex(0, docHeadless.Length(), 0, &docHeadless);
+		plex->Fold(0, docHeadless.Length(), 0, &docHeadless);
+		const auto [styledTextHeadless, foldedTextHeadless] = MarkedAndFoldedDocument(&docHeadless);
+		success = success && CheckSame(styledText, styledTextHeadless, "headless styles", suffixStyled, path);
+		success = success && CheckSame(foldedText, foldedTextHeadless, "headless folds", suffixFolded, path);
+	}
+
+	// A clone shares the configuration of plex so should give the same results
+	if (success) {
+		Scintilla::ILexer5 *plexClone = Lexilla::CloneLexer(plex);
+		if (plexClone) {
+			TestDocument docClone;
+			docClone.Set(text);
+			plexClone->Lex(0, docClone.Length(), 0, &docClone);
+			plexClone->Fold(0, docClone.Length(), 0, &docClone);
+			const auto [styledTextClone, foldedTextClone] = MarkedAndFoldedDocument(&docClone);
+			success = success && CheckSame(styledText, styledTextClone, "clone styles", suffixStyled, path);
+			success = success && CheckSame(foldedText, foldedTextClone, "clone folds", suffixFolded, path);
+			plexClone->Release();
+		}
+	}
+
 	if (propertyMap.GetPropertyValue("testlexers.list.styles").value_or(0)) {
 		std::vector<bool> used(0x80);
 		for (Sci_Position pos = 0; pos < pdoc->Length(); pos++) {
@@ -862,6 +928,14 @@ bool TestFile(const std::filesystem::path &path, const PropertyMap &propertyMap)
 		success = TestCRLF(path, text, plexCRLF, disablePerLineTests);
 	}
 
+	const int benchmarkSize = propertyMap.GetPropertyValue("testlexers.benchmark.size").value_or(0);
+	if (success && benchmarkSize > 0) {
+		Scintilla::ILexer5 *plexBenchmark = Lexilla::MakeLexer(*language);
+		SetProperties(plexBenchmark, propertyMap, path.filename().string());
+		BenchmarkFile(path, text, plexBenchmark, benchmarkSize);
+		plexBenchmark->Release();
+	}
+
 	return success;
 }
 
@@ -886,6 +960,115 @@ bool TestDirectory(std::filesystem::path directory, std::filesystem::path basePa
 	return success;
 }
 
+// An edit that has caused lexers to keep state that was not valid for the changed text.
+struct Relex {
+	std::string_view language;
+	std::vector<std::pair<std::string, std::string>> properties;
+	std::string_view before;
+	std::string_view after;
+	// Restyling after the edit is split at the start of this line when it is greater than 0
+	Sci_Position lineSplit = 0;
+};
+
+const Relex relexes[] = {
+	// PHP strings continuing over line ends inside Django and Mako blocks
+	{ "hypertext", { {"lexer.html.django", "1"} }, "{%def><?\"\n'!-{%i", "{%def><?\"\n{%i" },
+	{ "hypertext", { {"lexer.html.mako", "1"} }, "<?\"\n##\n\"\n<##", "<?\"\n##\n<?php \"\n<##", 3 },
+	// Fold level inside a PHP string
+	{ "hypertext", { {"fold", "1"}, {"fold.html", "1"}, {"fold.html.preprocessor", "1"}, {"fold.hypertext.heredoc", "1"} },
+		"<?'\\\nx=''\n", "<?'\\\n<<<'EOT'\n''\n" },
+};
+
+void LexRange(Scintilla::ILexer5 *plex, TestDocument &doc, Sci_Position start, Sci_Position end) {
+	const int styleStart = (start > 0) ? doc.StyleAt(start - 1) : 0;
+	plex->Lex(start, end - start, styleStart, &doc);
+	plex->Fold(start, end - start, styleStart, &doc);
+}
+
+// Lex the text before an edit then restyle from the line of the edit as an application
+// would and check the result is the same as lexing the changed text from the start.
+bool TestRelex(const Relex &relex) {
+	Scintilla::ILexer5 *plex = Lexilla::MakeLexer(std::string(relex.language));
+	Scintilla::ILexer5 *plexFull = Lexilla::MakeLexer(std::string(relex.language));
+	for (const auto &[key, val] : relex.properties) {
+		plex->PropertySet(key.c_str(), val.c_str());
+		plexFull->PropertySet(key.c_str(), val.c_str());
+	}
+
+	TestDocument doc;
+	doc.Set(relex.before);
+	LexRange(plex, doc, 0, doc.Length());
+
+	// Set retains the styles, line states and fold levels from before for the unchanged lines
+	const std::string_view::size_type sameLength = std::mismatch(relex.before.begin(), relex.before.end(),
+		relex.after.begin(), relex.after.end()).first - relex.before.begin();
+	doc.Set(relex.after);
+	const Sci_Position startLine = doc.LineStart(doc.LineFromPosition(sameLength));
+	if (relex.lineSplit > 0) {
+		const Sci_Position split = doc.LineStart(relex.lineSplit);
+		LexRange(plex, doc, startLine, split);
+		LexRange(plex, doc, split, doc.Length());
+	} else {
+		LexRange(plex, doc, startLine, doc.Length());
+	}
+
+	TestDocument docFull;
+	docFull.Set(relex.after);
+	LexRange(plexFull, docFull, 0, docFull.Length());
+
+	const auto [styledText, foldedText] = MarkedAndFoldedDocument(&doc);
+	const auto [styledTextFull, foldedTextFull] = MarkedAndFoldedDocument(&docFull);
+	plex->Release();
+	plexFull->Release();
+	if ((styledText == styledTextFull) && (foldedText == foldedTextFull)) {
+		return true;
+	}
+	std::cout << "\nRelex of " << relex.language << " differs from lexing whole document\n" <<
+		styledText << "\n" << styledTextFull << "\n" << foldedText << "\n" << foldedTextFull << "\n\n";
+	return false;
+}
+
+// A line long enough for lexers to add checkpoints inside it, made by repeating a piece.
+struct LongLine {
+	std::string_view language;
+	std::string_view prefix;
+	std::string_view piece;
+};
+
+const LongLine longLines[] = {
+	{ "cpp", "", "int a = 1; /* c */ s = \"x\"; " },
+	{ "json", "[", "{\"a\": [1, \"b\"]}, " },
+	{ "hypertext", "", "<b class=\"x\">text</b> " },
+};
+
+// Lex a long line, clear its styles as SCI_CLEARDOCUMENTSTYLE does, then lex it again
+// with the same lexer and check the styles are set again.
+bool TestClearedStyles(const LongLine &longLine) {
+	std::string text(longLine.prefix);
+	while (text.length() < 0x40000) {
+		text += longLine.piece;
+	}
+	Scintilla::ILexer5 *plex = Lexilla::MakeLexer(std::string(longLine.language));
+
+	TestDocument doc;
+	doc.Set(text);
+	LexRange(plex, doc, 0, doc.Length());
+
+	TestDocument docCleared;
+	docCleared.Set(text);
+	LexRange(plex, docCleared, 0, docCleared.Length());
+
+	const auto [styledText, foldedText] = MarkedAndFoldedDocument(&doc);
+	const auto [styledTextCleared, foldedTextCleared] = MarkedAndFoldedDocument(&docCleared);
+	plex->Release();
+	if ((styledText == styledTextCleared) && (foldedText == foldedTextCleared)) {
+		return true;
+	}
+	std::cout << "\nStyles of " << longLine.language << " differ after clearing and lexing again at byte " <<
+		FirstDifferent(styledText, styledTextCleared) << "\n\n";
+	return false;
+}
+
 bool AccessLexilla(std::filesystem::path basePath) {
 	if (!std::filesystem::exists(basePath)) {
 		std::cout << "No examples at " << basePath.string() << "\n";
@@ -901,6 +1084,16 @@ bool AccessLexilla(std::filesystem::path basePath) {
 			}
 		}
 	}
+	for (const Relex &relex : relexes) {
+		if (!TestRelex(relex)) {
+			success = false;
+		}
+	}
+	for (const LongLine &longLine : longLines) {
+		if (!TestClearedStyles(longLine)) {
+			success = false;
+		}
+	}
 	return success;
 }
 
@@ -0,0 +1,12 @@
+// Folding of comments, explicit markers, and preprocessor directives
+/* TODO comment with task marker
+   end */
+int a; /* TODO inside */ int b;
+/* a *//* b */ {
+}
+//{ explicit marker
+int c;
+//} explicit marker
+# if X
+#define STR(x) #x
+# endif
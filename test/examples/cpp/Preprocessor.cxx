@@ -0,0 +1,60 @@
+// Evaluation of preprocessor conditionals
+// Sections named yes_ should be active and no_ inactive
+#define ONE 1
+#define TWO (ONE + ONE)
+#define SQUARE(x) ((x) * (x))
+#define ADD(a, b) (a + b)
+#define FIRST(x, ...) x
+#define VERSION 0x010203
+
+#if TWO * 3 == 6
+int yes_precedence;
+#endif
+#if 2 + 3 * 4 == 20
+int no_precedence;
+#endif
+#if SQUARE(1 + 2) == 9
+int yes_macro_argument_expression;
+#endif
+#if ADD(SQUARE(2), TWO) == 6
+int yes_nested_macro;
+#endif
+#if FIRST(0, 1, 2)
+int no_variadic;
+#endif
+#if (1 << 40) > 0 && (VERSION >> 8) == 0x0102
+int yes_shift_64_bit;
+#endif
+#if -1 < 0 && ~0 == -1 && 0b101 == 5 && 017 == 15 && 1'000 == 1000
+int yes_literals;
+#endif
+#if 'A' == 65 && '\n' == 10
+int yes_character;
+#endif
+#if ONE ? 0 : 1
+int no_ternary;
+#elif TWO > ONE ? ONE : 0
+int yes_ternary;
+#endif
+#if (5 & 3) == 1 && (5 | 3) == 7 && (5 ^ 3) == 6 && 7 % 4 == 3
+int yes_bitwise;
+#endif
+#if defined ONE && defined(TWO) && !defined THREE
+int yes_defined;
+#endif
+#if __has_include(<stdio.h>)
+int no_has_include;
+#endif
+#if UNDEFINED_NAME || SQUARE
+int no_undefined;
+#endif
+#if 1 +
+int no_invalid;
+#endif
+#if 1 / 0
+int yes_division_by_zero;
+#endif
+#undef ONE
+#if defined(ONE) || TWO
+int no_undef;
+#endif
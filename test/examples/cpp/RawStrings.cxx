@@ -0,0 +1,18 @@
+// Raw strings with delimiters
+const char *empty = R"()";
+const char *plain = R"(text with " and ) inside)";
+const char *delimited = R"sql(SELECT ")" FROM t)sql";
+const char *multiLine = R"glsl(
+void main() {
+	gl_FragColor = vec4(1.0);
+}
+)glsl";
+const char *prefixed = u8R"x(a)" b)x";
+// Longest delimiter allowed is 16 characters
+const char *longest = R"0123456789abcdef(
+)0123456789abcde"
+)0123456789abcdef";
+int after = 1;
+// Longer delimiters are invalid so the string is not terminated
+const char *tooLong = R"0123456789abcdefg(x)0123456789abcdefg";
+int unreached = 2;
@@ -0,0 +1,24 @@
+# Stacked here-docs: bodies follow one another after the line that starts them
+print <<A, <<"B", <<'C';
+first $x
+A
+second $y
+B
+third $z
+C
+my $n = 1 << 2;
+
+# Left shift between here-docs does not lose the first one
+print <<~D . (1 << 3) . <<`E`;
+    indented
+    D
+ls -l
+E
+
+# Unterminated quote is an error but the bodies still follow
+print <<"F", <<'G
+body f
+F
+body g
+G
+print "done\n";
@@ -4,7 +4,7 @@
 DEL = del /q
 EXE = TestLexers.exe
 
-INCLUDEDIRS = -I ../../scintilla/include -I ../include -I ../access
+INCLUDEDIRS = -I ../../scintilla/include -I ../include -I ../access -I ../lexlib
 
 !IFDEF LEXILLA_STATIC
 STATIC_FLAG = -D LEXILLA_STATIC
@@ -19,7 +19,7 @@ DEBUG_OPTIONS = -O1 -MT -DNDEBUG $(STATIC_FLAG) -GL
 
 CXXFLAGS = /EHsc /std:c++latest $(DEBUG_OPTIONS) $(INCLUDEDIRS)
 
-OBJS = TestLexers.obj TestDocument.obj LexillaAccess.obj
+OBJS = TestLexers.obj TestDocument.obj LexillaAccess.obj HeadlessDocument.obj
 
 all: $(EXE)
 
@@ -40,5 +40,6 @@ $(EXE): $(OBJS) $(LIBS)
 .cxx.obj::
 	$(CXX) $(CXXFLAGS) -c $<
 
-TestLexers.obj: $*.cxx TestDocument.h
+TestLexers.obj: $*.cxx TestDocument.h ../include/IDocumentStyles.h ../access/HeadlessDocument.h
 TestDocument.obj: $*.cxx $*.h
+HeadlessDocument.obj: ../access/$*.cxx ../include/IDocumentStyles.h ../access/$*.h ../lexlib/UTF8Decode.h
@@ -12,12 +12,17 @@ CXXFLAGS = /EHsc /std:c++17 /D_HAS_AUTO_PTR_ETC=1 /wd 4805 $(INCLUDEDIRS)
 TESTSRC=test*.cxx
 # Files being tested from scintilla/src directory
 TESTEDSRC=\
+ ../../lexers/LexCPP.cxx \
  ../../lexlib/Accessor.cxx \
+ ../../lexlib/CharacterCategory.cxx \
  ../../lexlib/CharacterSet.cxx \
+ ../../lexlib/LexAccessor.cxx \
  ../../lexlib/LexerBase.cxx \
  ../../lexlib/LexerModule.cxx \
  ../../lexlib/LexerSimple.cxx \
+ ../../lexlib/MacroDatabase.cxx \
  ../../lexlib/PropSetSimple.cxx \
+ ../../lexlib/StyleContext.cxx \
  ../../lexlib/WordList.cxx
 
 TESTS=$(EXE)
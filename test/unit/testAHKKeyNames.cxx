@@ -0,0 +1,58 @@
+/** @file testAHKKeyNames.cxx
+ ** Unit Tests for Lexilla internal data structures
+ **/
+
+#include <string_view>
+
+#include "AHKKeyNames.h"
+
+#include "catch.hpp"
+
+using namespace Lexilla;
+
+// Test IsAHKKeyName.
+
+TEST_CASE("AHKKeyNames") {
+
+	SECTION("AllNames") {
+		for (const std::string_view name : ahkKeyNames) {
+			REQUIRE(IsAHKKeyName(name));
+		}
+	}
+
+	SECTION("CaseInsensitive") {
+		REQUIRE(IsAHKKeyName("LButton"));
+		REQUIRE(IsAHKKeyName("NUMPADENTER"));
+		REQUIRE(IsAHKKeyName("Media_Play_Pause"));
+	}
+
+	SECTION("NotNames") {
+		REQUIRE(!IsAHKKeyName(""));
+		REQUIRE(!IsAHKKeyName("a"));
+		REQUIRE(!IsAHKKeyName("f25"));
+		REQUIRE(!IsAHKKeyName("numpad"));
+		REQUIRE(!IsAHKKeyName("lbuttons"));
+		REQUIRE(!IsAHKKeyName("scroll"));
+		REQUIRE(!IsAHKKeyName("ctrl "));
+		REQUIRE(!IsAHKKeyName("\x80"));
+	}
+
+	SECTION("VirtualKeysAndScanCodes") {
+		REQUIRE(IsAHKKeyName("vk1B"));
+		REQUIRE(IsAHKKeyName("sc15D"));
+		REQUIRE(IsAHKKeyName("vkA2sc01D"));
+		REQUIRE(!IsAHKKeyName("vk"));
+		REQUIRE(!IsAHKKeyName("sc"));
+		REQUIRE(!IsAHKKeyName("vkG1"));
+		REQUIRE(!IsAHKKeyName("vk1Bsc"));
+		REQUIRE(!IsAHKKeyName("sc01Dvk1B"));
+	}
+
+	SECTION("Views") {
+		// Only the characters inside the view are examined
+		constexpr std::string_view line = "XButton1::Browser_Back";
+		REQUIRE(IsAHKKeyName(line.substr(0, 8)));
+		REQUIRE(IsAHKKeyName(line.substr(10)));
+		REQUIRE(!IsAHKKeyName(line));
+	}
+}
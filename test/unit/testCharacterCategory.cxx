@@ -0,0 +1,136 @@
+/** @file testCharacterCategory.cxx
+ ** Unit Tests for Lexilla internal data structures
+ **/
+
+#include <string>
+#include <vector>
+
+#include "CharacterCategory.h"
+
+#include "catch.hpp"
+
+using namespace Lexilla;
+
+namespace {
+
+// Definitions from UAX #31 applied to categories expanded from the ranges, for
+// checking the table of identifier classes used by IsIdStart and similar.
+
+bool IsOtherIdStart(int ch) noexcept {
+	return ch == 0x1885 || ch == 0x1886 || ch == 0x2118 || ch == 0x212E || ch == 0x309B || ch == 0x309C;
+}
+
+bool IsOtherIdContinue(int ch) noexcept {
+	return ch == 0xB7 || ch == 0x387 || (ch >= 0x1369 && ch <= 0x1371) || ch == 0x19DA;
+}
+
+bool IsPatternSyntax(int ch) noexcept {
+	return ch == 0x2E2F;
+}
+
+bool IdStartReference(int ch, CharacterCategory c) noexcept {
+	if (IsPatternSyntax(ch))
+		return false;
+	return IsOtherIdStart(ch) ||
+		c == ccLu || c == ccLl || c == ccLt || c == ccLm || c == ccLo || c == ccNl;
+}
+
+bool IdContinueReference(int ch, CharacterCategory c) noexcept {
+	if (IsPatternSyntax(ch))
+		return false;
+	return IdStartReference(ch, c) || IsOtherIdContinue(ch) ||
+		c == ccMn || c == ccMc || c == ccNd || c == ccPc;
+}
+
+// Characters whose NFKC forms are not identifiers so are removed from XID
+bool OmittedFromXid(int ch) noexcept {
+	return ch == 0x37A || ch == 0x309B || ch == 0x309C ||
+		(ch >= 0xFC5E && ch <= 0xFC63) || ch == 0xFDFA || ch == 0xFDFB ||
+		(ch >= 0xFE70 && ch <= 0xFE7E && (ch % 2) == 0);
+}
+
+bool XidStartReference(int ch, CharacterCategory c) noexcept {
+	if (OmittedFromXid(ch) || ch == 0xE33 || ch == 0xEB3 || ch == 0xFF9E || ch == 0xFF9F)
+		return false;
+	return IdStartReference(ch, c);
+}
+
+bool XidContinueReference(int ch, CharacterCategory c) noexcept {
+	if (OmittedFromXid(ch))
+		return false;
+	return IdContinueReference(ch, c);
+}
+
+}
+
+// Test CharacterCategory.
+
+TEST_CASE("CharacterCategory") {
+
+	SECTION("SameAsMap") {
+		// CharacterCategoryMap is filled directly from the ranges
+		CharacterCategoryMap ccm;
+		ccm.Optimize(0x110000);
+		for (int ch = 0; ch < 0x110000; ch++) {
+			if (CategoriseCharacter(ch) != ccm.CategoryFor(ch)) {
+				REQUIRE(CategoriseCharacter(ch) == ccm.CategoryFor(ch));
+			}
+		}
+		REQUIRE(ccCn == CategoriseCharacter(-1));
+		REQUIRE(ccCn == CategoriseCharacter(0x110000));
+	}
+
+	SECTION("IdentifiersSameAsRanges") {
+		CharacterCategoryMap ccm;
+		ccm.Optimize(0x110000);
+		for (int ch = 0; ch < 0x110000; ch++) {
+			const CharacterCategory c = ccm.CategoryFor(ch);
+			if ((IsIdStart(ch) != IdStartReference(ch, c)) ||
+				(IsIdContinue(ch) != IdContinueReference(ch, c)) ||
+				(IsXidStart(ch) != XidStartReference(ch, c)) ||
+				(IsXidContinue(ch) != XidContinueReference(ch, c))) {
+				INFO("Character " << ch);
+				REQUIRE(IsIdStart(ch) == IdStartReference(ch, c));
+				REQUIRE(IsIdContinue(ch) == IdContinueReference(ch, c));
+				REQUIRE(IsXidStart(ch) == XidStartReference(ch, c));
+				REQUIRE(IsXidContinue(ch) == XidContinueReference(ch, c));
+			}
+		}
+		REQUIRE(!IsIdStart(-1));
+		REQUIRE(!IsIdContinue(0x110000));
+	}
+
+	SECTION("Categories") {
+		REQUIRE(ccLu == CategoriseCharacter('A'));
+		REQUIRE(ccNd == CategoriseCharacter('1'));
+		REQUIRE(ccLl == CategoriseCharacter(0x3B1));	// GREEK SMALL LETTER ALPHA
+		REQUIRE(ccLo == CategoriseCharacter(0x4E2D));	// CJK UNIFIED IDEOGRAPH-4E2D
+		REQUIRE(ccLl == CategoriseCharacter(0x1D465));	// MATHEMATICAL ITALIC SMALL X
+	}
+
+	SECTION("Identifiers") {
+		REQUIRE(IsXidStart('a'));
+		REQUIRE(!IsXidStart('1'));
+		REQUIRE(IsXidContinue('1'));
+		REQUIRE(!IsXidContinue(' '));
+		REQUIRE(IsXidStart(0x3B1));
+		REQUIRE(IsXidContinue(0x3B1));
+		REQUIRE(IsXidStart(0x1D465));
+		REQUIRE(IsXidContinue(0x1D7CE));	// MATHEMATICAL BOLD DIGIT ZERO
+		REQUIRE(!IsXidStart(0x1D7CE));
+		// Other_ID_Start and Other_ID_Continue
+		REQUIRE(IsIdStart(0x2118));
+		REQUIRE(!IsIdStart(0xB7));
+		REQUIRE(IsIdContinue(0xB7));
+		// Pattern_Syntax
+		REQUIRE(!IsIdStart(0x2E2F));
+		REQUIRE(!IsIdContinue(0x2E2F));
+		// In ID but not XID
+		REQUIRE(IsIdStart(0x309B));
+		REQUIRE(!IsXidStart(0x309B));
+		REQUIRE(!IsXidContinue(0x309B));
+		REQUIRE(IsIdStart(0x0E33));
+		REQUIRE(!IsXidStart(0x0E33));
+		REQUIRE(IsXidContinue(0x0E33));
+	}
+}
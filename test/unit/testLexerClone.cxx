@@ -0,0 +1,108 @@
+/** @file testLexerClone.cxx
+ ** Unit Tests for Lexilla internal data structures
+ **/
+
+#include <cstring>
+
+#include <string>
+#include <string_view>
+
+#include "ILexer.h"
+#include "Scintilla.h"
+#include "SciLexer.h"
+
+#include "LexerModule.h"
+#include "LexerClone.h"
+
+#include "catch.hpp"
+
+using namespace Lexilla;
+
+extern LexerModule lmCPP;
+
+namespace {
+
+Scintilla::ILexer5 *Clone(Scintilla::ILexer5 *prototype) {
+	return static_cast<Scintilla::ILexer5 *>(prototype->PrivateCall(privateCallClone, nullptr));
+}
+
+std::string_view Property(Scintilla::ILexer5 *lexer, const char *key) {
+	const char *value = lexer->PropertyGet(key);
+	REQUIRE(value);
+	return value;
+}
+
+}
+
+// Test that a clone shares the configuration of its prototype until either changes it.
+
+TEST_CASE("LexerClone") {
+
+	Scintilla::ILexer5 *prototype = lmCPP.Create();
+	REQUIRE(prototype);
+	REQUIRE(prototype->PropertySet("fold", "1") == 0);
+	REQUIRE(prototype->WordListSet(0, "int char") == 0);
+	REQUIRE(prototype->WordListSet(4, "DEBUG=1") == 0);
+	Scintilla::ILexer5 *clone = Clone(prototype);
+	REQUIRE(clone);
+
+	SECTION("Shared") {
+		REQUIRE(Property(clone, "fold") == "1");
+		// Setting what is already shared is not a change
+		REQUIRE(clone->PropertySet("fold", "1") == -1);
+		REQUIRE(clone->WordListSet(0, "int char") == -1);
+		REQUIRE(clone->WordListSet(4, "DEBUG=1") == -1);
+		REQUIRE(prototype->PropertySet("fold", "1") == -1);
+	}
+
+	SECTION("PropertySet") {
+		REQUIRE(clone->PropertySet("fold", "0") == 0);
+		REQUIRE(Property(clone, "fold") == "0");
+		REQUIRE(Property(prototype, "fold") == "1");
+		REQUIRE(prototype->PropertySet("fold.comment", "1") == 0);
+		REQUIRE(Property(prototype, "fold.comment") == "1");
+		REQUIRE(Property(clone, "fold.comment").empty());
+	}
+
+	SECTION("WordListSet") {
+		REQUIRE(clone->WordListSet(0, "void") == 0);
+		REQUIRE(clone->WordListSet(0, "void") == -1);
+		// The prototype still has its own list
+		REQUIRE(prototype->WordListSet(0, "int char") == -1);
+		REQUIRE(clone->WordListSet(4, "NDEBUG") == 0);
+		REQUIRE(prototype->WordListSet(4, "DEBUG=1") == -1);
+	}
+
+	SECTION("AllocateSubStyles") {
+		REQUIRE(prototype->AllocateSubStyles(SCE_C_IDENTIFIER, 1) > 0);
+		REQUIRE(clone->SubStylesLength(SCE_C_IDENTIFIER) == 0);
+		const int start = clone->AllocateSubStyles(SCE_C_IDENTIFIER, 2);
+		REQUIRE(start > 0);
+		REQUIRE(clone->SubStylesStart(SCE_C_IDENTIFIER) == start);
+		REQUIRE(clone->SubStylesLength(SCE_C_IDENTIFIER) == 2);
+		REQUIRE(prototype->SubStylesLength(SCE_C_IDENTIFIER) == 1);
+		clone->SetIdentifiers(start, "size_t");
+		// Freeing the clone's substyles leaves those of the prototype
+		clone->FreeSubStyles();
+		REQUIRE(clone->SubStylesLength(SCE_C_IDENTIFIER) == 0);
+		REQUIRE(prototype->SubStylesLength(SCE_C_IDENTIFIER) == 1);
+	}
+
+	SECTION("OtherOperations") {
+		REQUIRE(!prototype->PrivateCall(0, nullptr));
+		REQUIRE(!prototype->PrivateCall(privateCallClone + 1, nullptr));
+	}
+
+	SECTION("ReleasePrototype") {
+		// The configuration lives on in the clone
+		prototype->Release();
+		prototype = nullptr;
+		REQUIRE(Property(clone, "fold") == "1");
+		REQUIRE(clone->WordListSet(0, "int char") == -1);
+	}
+
+	clone->Release();
+	if (prototype) {
+		prototype->Release();
+	}
+}
@@ -0,0 +1,211 @@
+/** @file testLineCheckpoints.cxx
+ ** Unit Tests for Lexilla internal data structures
+ **/
+
+#include <cstdint>
+#include <cassert>
+#include <cstring>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+#include "ILexer.h"
+
+#include "LexAccessor.h"
+#include "LineCheckpoints.h"
+
+#include "catch.hpp"
+
+using namespace Lexilla;
+
+namespace {
+
+// Document of a single line, just enough for LexAccessor.
+class LineDocument : public Scintilla::IDocument {
+	Sci_Position endStyled = 0;
+public:
+	std::string text;
+	std::string styles;
+	explicit LineDocument(std::string_view text_) : text(text_), styles(text_.length(), 0) {
+	}
+	virtual ~LineDocument() = default;
+	int SCI_METHOD Version() const override {
+		return Scintilla::dvRelease4;
+	}
+	void SCI_METHOD SetErrorStatus(int) override {
+	}
+	Sci_Position SCI_METHOD Length() const override {
+		return text.length();
+	}
+	void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const override {
+		text.copy(buffer, lengthRetrieve, position);
+	}
+	char SCI_METHOD StyleAt(Sci_Position position) const override {
+		return styles.at(position);
+	}
+	Sci_Position SCI_METHOD LineFromPosition(Sci_Position) const override {
+		return 0;
+	}
+	Sci_Position SCI_METHOD LineStart(Sci_Position line) const override {
+		return (line > 0) ? Length() : 0;
+	}
+	int SCI_METHOD GetLevel(Sci_Position) const override {
+		return 0;
+	}
+	int SCI_METHOD SetLevel(Sci_Position, int) override {
+		return 0;
+	}
+	int SCI_METHOD GetLineState(Sci_Position) const override {
+		return 0;
+	}
+	int SCI_METHOD SetLineState(Sci_Position, int) override {
+		return 0;
+	}
+	void SCI_METHOD StartStyling(Sci_Position position) override {
+		endStyled = position;
+	}
+	bool SCI_METHOD SetStyleFor(Sci_Position length, char style) override {
+		styles.replace(endStyled, length, length, style);
+		endStyled += length;
+		return true;
+	}
+	bool SCI_METHOD SetStyles(Sci_Position length, const char *styles_) override {
+		styles.replace(endStyled, length, styles_, length);
+		endStyled += length;
+		return true;
+	}
+	void SCI_METHOD DecorationSetCurrentIndicator(int) override {
+	}
+	void SCI_METHOD DecorationFillRange(Sci_Position, int, Sci_Position) override {
+	}
+	void SCI_METHOD ChangeLexerState(Sci_Position, Sci_Position) override {
+	}
+	int SCI_METHOD CodePage() const override {
+		return 0;
+	}
+	bool SCI_METHOD IsDBCSLeadByte(char) const override {
+		return false;
+	}
+	const char *SCI_METHOD BufferPointer() override {
+		return text.c_str();
+	}
+	int SCI_METHOD GetLineIndentation(Sci_Position) override {
+		return 0;
+	}
+	Sci_Position SCI_METHOD LineEnd(Sci_Position) const override {
+		return Length();
+	}
+	Sci_Position SCI_METHOD GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const override {
+		return positionStart + characterOffset;
+	}
+	int SCI_METHOD GetCharacterAndWidth(Sci_Position position, Sci_Position *pWidth) const override {
+		if (pWidth)
+			*pWidth = 1;
+		return static_cast<unsigned char>(text[position]);
+	}
+};
+
+constexpr char styleLexed = 1;
+
+// Pretend to lex the whole document, adding a checkpoint whenever one is due
+// with the position as state and styling all of it as styleLexed.
+// Returns where lexing started.
+Sci_PositionU LexAll(LineCheckpoints<Sci_PositionU> &checkpoints, LineDocument &doc) {
+	LexAccessor styler(&doc);
+	const Sci_PositionU endPos = doc.Length();
+	Sci_PositionU state = 0;
+	const Sci_PositionU resumePos = checkpoints.Resume(styler, 0, endPos, state);
+	REQUIRE(state == resumePos);
+	styler.StartAt(resumePos);
+	styler.StartSegment(resumePos);
+	for (Sci_PositionU pos = resumePos; pos < endPos; pos++) {
+		if (checkpoints.Due(pos)) {
+			checkpoints.Add(styler, pos, pos);
+		}
+	}
+	styler.ColourTo(endPos - 1, styleLexed);
+	styler.Flush();
+	checkpoints.Styled(styler);
+	return resumePos;
+}
+
+}
+
+// Test LineCheckpoints.
+
+TEST_CASE("LineCheckpoints") {
+
+	constexpr Sci_PositionU spacing = 100;
+	LineCheckpoints<Sci_PositionU> checkpoints(spacing);
+	LineDocument doc(std::string(20000, 'a'));
+
+	SECTION("IsEmptyInitially") {
+		REQUIRE(0u == checkpoints.size());
+	}
+
+	SECTION("ShortLineHasNoCheckpoints") {
+		LineDocument docShort("abc");
+		REQUIRE(0u == LexAll(checkpoints, docShort));
+		REQUIRE(0u == checkpoints.size());
+	}
+
+	SECTION("AddEverySpacing") {
+		REQUIRE(0u == LexAll(checkpoints, doc));
+		REQUIRE(199u == checkpoints.size());
+	}
+
+	SECTION("ResumeFromLastWhenUnchanged") {
+		LexAll(checkpoints, doc);
+		REQUIRE(19900u == LexAll(checkpoints, doc));
+		REQUIRE(199u == checkpoints.size());
+	}
+
+	SECTION("ResumeBeforeChange") {
+		LexAll(checkpoints, doc);
+		doc.text[10050] = 'b';
+		// Text within lookAhead of a checkpoint may have changed how its state was reached
+		const Sci_PositionU resumePos = LexAll(checkpoints, doc);
+		REQUIRE(resumePos < 10050 - LineCheckpoints<Sci_PositionU>::lookAhead);
+		REQUIRE(resumePos >= 10050 - LineCheckpoints<Sci_PositionU>::lookAhead - spacing);
+		// Checkpoints after the change were added again
+		REQUIRE(199u == checkpoints.size());
+		REQUIRE(19900u == LexAll(checkpoints, doc));
+	}
+
+	SECTION("ResumeFromStartWhenStylesCleared") {
+		LexAll(checkpoints, doc);
+		// Styles may be reset without changing the text
+		doc.styles.assign(doc.styles.length(), 0);
+		REQUIRE(0u == LexAll(checkpoints, doc));
+		REQUIRE(doc.styles == std::string(doc.styles.length(), styleLexed));
+		REQUIRE(19900u == LexAll(checkpoints, doc));
+	}
+
+	SECTION("ResumeBeforeStyleChange") {
+		LexAll(checkpoints, doc);
+		doc.styles[10050] = 0;
+		const Sci_PositionU resumePos = LexAll(checkpoints, doc);
+		REQUIRE(resumePos <= 10050);
+		REQUIRE(resumePos >= 10050 - spacing);
+		REQUIRE(doc.styles[10050] == styleLexed);
+		REQUIRE(19900u == LexAll(checkpoints, doc));
+	}
+
+	SECTION("ResumeFromStartWhenStateDiffers") {
+		LexAll(checkpoints, doc);
+		LexAccessor styler(&doc);
+		Sci_PositionU state = 1;
+		REQUIRE(0u == checkpoints.Resume(styler, 0, doc.Length(), state));
+		REQUIRE(1u == state);
+		REQUIRE(0u == checkpoints.size());
+	}
+
+	SECTION("Clear") {
+		LexAll(checkpoints, doc);
+		checkpoints.Clear();
+		REQUIRE(0u == checkpoints.size());
+		REQUIRE(0u == LexAll(checkpoints, doc));
+	}
+}
@@ -0,0 +1,149 @@
+/** @file testMacroDatabase.cxx
+ ** Unit Tests for Lexilla internal data structures
+ **/
+
+#include <cstdint>
+#include <cstdio>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <fstream>
+
+#include "MacroDatabase.h"
+
+#include "catch.hpp"
+
+using namespace Lexilla;
+
+namespace {
+
+void AppendUInt32(std::string &s, size_t value) {
+	for (int byte = 0; byte < 4; byte++) {
+		s.push_back(static_cast<char>((value >> (byte * 8)) & 0xff));
+	}
+}
+
+// Same layout as scripts/MacroDatabase.py produces, definitions must already be sorted
+std::string Compile(const std::vector<MacroDatabase::Definition> &definitions) {
+	std::string header = "LXMACRO1";
+	AppendUInt32(header, definitions.size());
+	const size_t textStart = header.length() + definitions.size() * 3 * 8;
+	std::string entries;
+	std::string text;
+	for (const MacroDatabase::Definition &definition : definitions) {
+		for (const std::string_view part : { definition.name, definition.arguments, definition.value }) {
+			AppendUInt32(entries, textStart + text.length());
+			AppendUInt32(entries, part.length());
+			text.append(part);
+		}
+	}
+	return header + entries + text;
+}
+
+}
+
+// Test MacroDatabase.
+
+TEST_CASE("MacroDatabase") {
+
+	const std::string contents = Compile({
+		{ "DEBUG", "", "1" },
+		{ "MAX", "a,b", "((a)>(b)?(a):(b))" },
+		{ "VERSION", "", "0x0203" },
+	});
+
+	SECTION("Find") {
+		std::shared_ptr<const MacroDatabase> database = MacroDatabase::FromMemory(contents);
+		REQUIRE(database);
+		REQUIRE(3u == database->Length());
+		MacroDatabase::Definition definition;
+		REQUIRE(database->Find("MAX", definition));
+		REQUIRE(definition.name == "MAX");
+		REQUIRE(definition.arguments == "a,b");
+		REQUIRE(definition.value == "((a)>(b)?(a):(b))");
+		REQUIRE(database->Find("DEBUG", definition));
+		REQUIRE(definition.value == "1");
+		REQUIRE(database->Find("VERSION", definition));
+		REQUIRE(definition.arguments.empty());
+		REQUIRE(!database->Find("MIN", definition));
+		REQUIRE(!database->Find("", definition));
+		REQUIRE(!database->Find("ZZZ", definition));
+	}
+
+	SECTION("Fingerprint") {
+		std::shared_ptr<const MacroDatabase> database = MacroDatabase::FromMemory(contents);
+		REQUIRE(database);
+		const uint64_t fingerprint =
+			MacroDatabase::HashDefinition("DEBUG", "", "1") ^
+			MacroDatabase::HashDefinition("MAX", "a,b", "((a)>(b)?(a):(b))") ^
+			MacroDatabase::HashDefinition("VERSION", "", "0x0203");
+		REQUIRE(fingerprint == database->Fingerprint());
+		REQUIRE(MacroDatabase::HashDefinition("A", "", "1") != MacroDatabase::HashDefinition("A", "1", ""));
+	}
+
+	SECTION("Invalid") {
+		REQUIRE(!MacroDatabase::FromMemory(""));
+		REQUIRE(!MacroDatabase::FromMemory("LXMACRO0\0\0\0\0"));
+		// Not sorted
+		const std::string unsorted = Compile({ { "B", "", "1" }, { "A", "", "1" } });
+		REQUIRE(!MacroDatabase::FromMemory(unsorted));
+		// Truncated so text is outside the data
+		REQUIRE(!MacroDatabase::FromMemory(std::string_view(contents).substr(0, contents.length() - 2)));
+		REQUIRE(!MacroDatabase::Open("doesnotexist.macros"));
+	}
+
+	SECTION("OpenShared") {
+		const char *path = "testMacroDatabase.macros";
+		{
+			std::ofstream file(path, std::ios::binary);
+			file << contents;
+		}
+		std::shared_ptr<const MacroDatabase> database = MacroDatabase::Open(path);
+		REQUIRE(database);
+		REQUIRE(3u == database->Length());
+		std::shared_ptr<const MacroDatabase> second = MacroDatabase::Open(path);
+		REQUIRE(database == second);
+		database.reset();
+		second.reset();
+		std::remove(path);
+	}
+
+	SECTION("Replaced") {
+		const char *path = "testMacroDatabase.macros";
+		const char *pathTemporary = "testMacroDatabase.macros.tmp";
+		{
+			std::ofstream file(path, std::ios::binary);
+			file << contents;
+		}
+		std::shared_ptr<const MacroDatabase> database = MacroDatabase::Open(path);
+		REQUIRE(database);
+		// Same size as the original so only the identity of the file differs
+		const std::string replacement = Compile({
+			{ "DEBUG", "", "0" },
+			{ "MAX", "a,b", "((a)>(b)?(a):(b))" },
+			{ "VERSION", "", "0x0204" },
+		});
+		REQUIRE(replacement.length() == contents.length());
+		{
+			std::ofstream file(pathTemporary, std::ios::binary);
+			file << replacement;
+		}
+		std::remove(path);
+		REQUIRE(std::rename(pathTemporary, path) == 0);
+		std::shared_ptr<const MacroDatabase> reopened = MacroDatabase::Open(path);
+		REQUIRE(reopened);
+		REQUIRE(reopened != database);
+		REQUIRE(reopened->Fingerprint() != database->Fingerprint());
+		MacroDatabase::Definition definition;
+		REQUIRE(reopened->Find("VERSION", definition));
+		REQUIRE(definition.value == "0x0204");
+		// The earlier database still sees the file as it was opened
+		REQUIRE(database->Find("VERSION", definition));
+		REQUIRE(definition.value == "0x0203");
+		database.reset();
+		reopened.reset();
+		std::remove(path);
+	}
+}
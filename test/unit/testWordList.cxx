@@ -38,11 +38,64 @@ TEST_CASE("WordList") {
 		// Changed order shouldn't be seen as a change
 		const bool changed3 = wl.Set("struct else");
 		REQUIRE(!changed3);
+		// Different separators aren't a change
+		const bool changedSeparators = wl.Set("else\tstruct\n");
+		REQUIRE(!changedSeparators);
+		// Adding to the end is a change
+		const bool changedLonger = wl.Set("else structure");
+		REQUIRE(changedLonger);
+		REQUIRE(wl.InList("structure"));
+		REQUIRE(!wl.InList("struct"));
+		// Removing from the end is a change
+		const bool changedShorter = wl.Set("else struc");
+		REQUIRE(changedShorter);
+		REQUIRE(wl.InList("struc"));
+		const bool changedSame = wl.Set("else struc");
+		REQUIRE(!changedSame);
 		// Removing word is a change
 		const bool changed4 = wl.Set("struct");
 		REQUIRE(changed4);
 	}
 
+	SECTION("Shared") {
+		// Lists set from the same text share their words
+		wl.Set("else struct");
+		WordList wl2;
+		wl2.Set("else\tstruct");
+		REQUIRE(wl.WordAt(0) == wl2.WordAt(0));
+		{
+			WordList wl3;
+			REQUIRE(wl3.Set("else struct"));
+			REQUIRE(wl.WordAt(1) == wl3.WordAt(1));
+		}
+		// Lists split only at line ends are separate
+		WordList wlLines(true);
+		wlLines.Set("else struct");
+		REQUIRE(1 == wlLines.Length());
+		REQUIRE(wl.WordAt(0) != wlLines.WordAt(0));
+		// Changing one list leaves the other alone
+		REQUIRE(wl2.Set("while"));
+		REQUIRE(wl.InList("struct"));
+		REQUIRE(!wl2.InList("struct"));
+	}
+
+	SECTION("Copy") {
+		// Copies share the words and stay valid after the original changes
+		wl.Set("else struct");
+		WordList wlCopy(wl);
+		REQUIRE(wl.WordAt(0) == wlCopy.WordAt(0));
+		REQUIRE(!wlCopy.Set("else struct"));
+		REQUIRE(wl.Set("while"));
+		REQUIRE(wlCopy.InList("struct"));
+		REQUIRE(!wl.InList("struct"));
+		wl = wlCopy;
+		REQUIRE(wl.InList("struct"));
+		WordList wlEmpty;
+		wl = wlEmpty;
+		REQUIRE(!wl);
+		REQUIRE(0 == wl.Length());
+	}
+
 	SECTION("WordAt") {
 		wl.Set("else struct");
 		REQUIRE(0 == strcmp(wl.WordAt(0), "else"));